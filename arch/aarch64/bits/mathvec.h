@@ -0,0 +1,13 @@
+#if defined(__FAST_MATH__) && __GNUC__ >= 9 && !defined(__clang__) \
+ && !defined(__ARM_FEATURE_SVE)
+#define __MVEC __attribute__((__simd__("notinbranch")))
+__MVEC double exp(double);
+__MVEC double log(double);
+__MVEC double pow(double, double);
+__MVEC double sin(double);
+__MVEC double cos(double);
+__MVEC float expf(float);
+__MVEC float logf(float);
+__MVEC float powf(float, float);
+#undef __MVEC
+#endif
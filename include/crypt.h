@@ -5,6 +5,9 @@
 extern "C" {
 #endif
 
+#define __NEED_size_t
+#include <bits/alltypes.h>
+
 struct crypt_data {
 	int initialized;
 	char __buf[256];
@@ -12,6 +15,7 @@ struct crypt_data {
 
 char *crypt(const char *, const char *);
 char *crypt_r(const char *, const char *, struct crypt_data *);
+void crypt_batch(const char *const *, const char *const *, struct crypt_data *, char **, size_t);
 
 #ifdef __cplusplus
 }
@@ -33,6 +33,30 @@ typedef struct {
 } Dl_info;
 int dladdr(const void *, Dl_info *);
 int dlinfo(void *, int, void *);
+
+#include <bits/alltypes.h>
+#include <bits/dlfcn.h>
+
+struct link_map;
+struct dl_find_object {
+	unsigned long long dlfo_flags;
+	void *dlfo_map_start;
+	void *dlfo_map_end;
+	struct link_map *dlfo_link_map;
+	void *dlfo_eh_frame;
+#if DLFO_STRUCT_HAS_EH_DBASE
+	void *dlfo_eh_dbase;
+#if __LONG_MAX == 0x7fffffffL
+	unsigned __dlfo_eh_dbase_pad;
+#endif
+#endif
+#if DLFO_STRUCT_HAS_EH_COUNT
+	int dlfo_eh_count;
+	unsigned __dlfo_eh_count_pad;
+#endif
+	unsigned long long __dlfo_reserved[7];
+};
+int _dl_find_object(void *, struct dl_find_object *);
 #endif
 
 #if _REDIR_TIME64
@@ -55,6 +55,17 @@ void regfree(regex_t *);
 
 size_t regerror(int, const regex_t *__restrict, char *__restrict, size_t);
 
+typedef struct {
+	size_t re_nset;
+	void *__opaque;
+} regset_t;
+
+#if defined(_GNU_SOURCE) || defined(_BSD_SOURCE)
+int regsetcomp(regset_t *__restrict, const char *const *__restrict, size_t, int);
+int regsetexec(const regset_t *__restrict, const char *__restrict, size_t, size_t *__restrict, int);
+void regsetfree(regset_t *);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
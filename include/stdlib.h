@@ -149,6 +149,15 @@ int clearenv(void);
 #define WIFCONTINUED(s) ((s) == 0xffff)
 void *reallocarray (void *, size_t, size_t);
 void qsort_r (void *, size_t, size_t, int (*)(const void *, const void *, void *), void *);
+int from_chars_ll (const char **, const char *, long long *, int);
+int from_chars_ull (const char **, const char *, unsigned long long *, int);
+int from_chars_d (const char **, const char *, double *);
+int from_chars_f (const char **, const char *, float *);
+#define FROM_CHARS_LL  1
+#define FROM_CHARS_ULL 2
+#define FROM_CHARS_D   3
+#define FROM_CHARS_F   4
+size_t from_chars_array (const char **, const char *, int, int, void *, size_t);
 #endif
 
 #ifdef _GNU_SOURCE
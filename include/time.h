@@ -130,6 +130,7 @@ struct tm *getdate (const char *);
 #if defined(_GNU_SOURCE) || defined(_BSD_SOURCE)
 int stime(const time_t *);
 time_t timegm(struct tm *);
+size_t strftime_times(char *__restrict, size_t, const char *__restrict, const time_t *__restrict, size_t, int);
 #endif
 
 #if _REDIR_TIME64
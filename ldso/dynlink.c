@@ -19,6 +19,8 @@
 #include <dlfcn.h>
 #include <semaphore.h>
 #include <sys/membarrier.h>
+#include <dirent.h>
+#include <time.h>
 #include "pthread_impl.h"
 #include "fork_impl.h"
 #include "libc.h"
@@ -43,6 +45,8 @@ static void (*error)(const char *, ...) = error_noop;
 
 #define MAXP2(a,b) (-(-(a)&-(b)))
 #define ALIGN(x,y) ((x)+(y)-1 & -(y))
+#define TLS_SURPLUS_MAX (1<<20)
+#define TLS_SURPLUS_ALIGN 64
 
 #define container_of(p,t,m) ((t*)((char *)(p)-offsetof(t,m)))
 #define countof(a) ((sizeof (a))/(sizeof (a)[0]))
@@ -90,6 +94,8 @@ struct dso {
 	char mark;
 	char bfs_built;
 	char runtime_loaded;
+	char published;
+	char pub_global;
 	struct dso **deps, *needed_by;
 	size_t ndeps_direct;
 	size_t next_dep;
@@ -103,6 +109,8 @@ struct dso {
 	struct td_index *td_index;
 	struct dso *fini_next;
 	char *shortname;
+	struct sym_index *volatile sym_index;
+	size_t reloc_cache_id;
 #if DL_FDPIC
 	unsigned char *base;
 #else
@@ -121,6 +129,32 @@ struct symdef {
 	struct dso *dso;
 };
 
+struct sym_index {
+	size_t cnt;
+	uint32_t sym[];
+};
+
+struct dlfo_table {
+	struct dso *tail;
+	struct dlfo_table *retired;
+	size_t cnt, cap;
+	struct dlfo_entry {
+		size_t start, end;
+		struct dso *dso;
+		void *eh_frame;
+		size_t eh_size;
+	} e[];
+};
+
+struct dso_ranges {
+	struct dso *tail;
+	size_t cnt;
+	struct dso_range {
+		size_t start, len;
+		struct dso *dso;
+	} r[];
+};
+
 typedef void (*stage3_func)(size_t *, size_t *);
 
 static struct builtin_tls {
@@ -135,7 +169,17 @@ static size_t *saved_addends, *apply_addends_to;
 
 static struct dso ldso;
 static struct dso *head, *tail, *fini_head, *syms_tail, *lazy_head;
-static char *env_path, *sys_path;
+static struct dso *pub_tail, *pub_syms_tail;
+static struct dso_ranges *volatile dso_ranges;
+static struct dlfo_table *dlfo_tables[2], *dlfo_retired;
+static volatile int dlfo_version, dlfo_readers;
+static char *env_reloc_cache;
+static int trace_fd = -1;
+static struct timespec trace_start;
+static size_t trace_opens, trace_mmaps;
+static int load_readahead;
+static char *env_tls_surplus;
+static char *env_path, *sys_path, *sys_index;
 static unsigned long long gencnt;
 static int runtime;
 static int ldd_mode;
@@ -143,11 +187,12 @@ static int ldso_fail;
 static int noload;
 static int shutting_down;
 static jmp_buf *rtld_fail;
+static pthread_mutex_t load_lock;
 static pthread_rwlock_t lock;
 static struct debug debug;
 static struct tls_module *tls_tail;
 static size_t tls_cnt, tls_offset, tls_align = MIN_TLS_ALIGN;
-static size_t static_tls_cnt;
+static size_t static_tls_cnt, static_tls_end;
 static pthread_mutex_t init_fini_lock;
 static pthread_cond_t ctor_cond;
 static struct dso *builtin_deps[2];
@@ -308,33 +353,82 @@ static Sym *gnu_lookup_filtered(uint32_t h1, uint32_t *hashtab, struct dso *dso,
 #define ARCH_SYM_REJECT_UND(s) 0
 #endif
 
+/* Whether sym, found by name in a DSO, is a usable definition. */
+static inline int sym_ok(Sym *sym, int need_def)
+{
+	if (!sym->st_shndx)
+		if (need_def || (sym->st_info&0xf) == STT_TLS
+		    || ARCH_SYM_REJECT_UND(sym))
+			return 0;
+	if (!sym->st_value)
+		if ((sym->st_info&0xf) != STT_TLS)
+			return 0;
+	if (!(1<<(sym->st_info&0xf) & OK_TYPES)) return 0;
+	if (!(1<<(sym->st_info>>4) & OK_BINDS)) return 0;
+	return 1;
+}
+
+/* The global symbol index holds, for every name defined in the global
+ * symbol list from head through gsym_tail, the result a search of that
+ * part of the list would give with and without need_def, so a search
+ * starting at head costs one probe plus a walk of any objects added
+ * after gsym_tail. It is built when the list first reaches
+ * GSYM_MIN_DSOS objects, below which walking the bloom filters is
+ * cheaper, and extended when dlopen publishes new global objects. */
+
+#define GSYM_MIN_DSOS 8
+
+struct gsym {
+	uint32_t h;
+	const char *name;
+	struct symdef any, def;
+};
+
+static struct gsym *gsym;
+static size_t gsym_mask, gsym_cnt;
+static struct dso *gsym_tail;
+
+static struct gsym *gsym_find(struct gsym *tab, size_t mask, const char *s, uint32_t h)
+{
+	size_t i;
+	for (i=h; tab[i&=mask].name; i++)
+		if (tab[i].h == h && !strcmp(tab[i].name, s))
+			break;
+	return tab+i;
+}
+
 #if defined(__GNUC__)
 __attribute__((always_inline))
 #endif
-static inline struct symdef find_sym2(struct dso *dso, const char *s, int need_def, int use_deps)
+/* If last is nonzero, the search is limited to published objects and
+ * ends at last, which is the end of the published global symbol list,
+ * so that a lookup running alongside dlopen sees none of the objects
+ * it is loading. It also only follows syms_next from objects on that
+ * list, since dlopen links other objects in temporarily while it
+ * relocates. */
+static inline struct symdef find_sym2(struct dso *dso, const char *s, int need_def, int use_deps, struct dso *last)
 {
 	uint32_t h = 0, gh = gnu_hash(s), gho = gh / (8*sizeof(size_t)), *ght;
 	size_t ghm = 1ul << gh % (8*sizeof(size_t));
 	struct symdef def = {0};
 	struct dso **deps = use_deps ? dso->deps : 0;
-	for (; dso; dso=use_deps ? *deps++ : dso->syms_next) {
+	if (dso == head && !use_deps && gsym) {
+		struct gsym *g = gsym_find(gsym, gsym_mask, s, gh);
+		def = need_def ? g->def : g->any;
+		if (def.sym || gsym_tail == last) return def;
+		dso = gsym_tail->syms_next;
+	}
+	for (; dso; dso=use_deps ? *deps++ :
+	            dso==last || last && !dso->pub_global ? 0 : dso->syms_next) {
 		Sym *sym;
+		if (last && !dso->published) break;
 		if ((ght = dso->ghashtab)) {
 			sym = gnu_lookup_filtered(gh, ght, dso, s, gho, ghm);
 		} else {
 			if (!h) h = sysv_hash(s);
 			sym = sysv_lookup(s, h, dso);
 		}
-		if (!sym) continue;
-		if (!sym->st_shndx)
-			if (need_def || (sym->st_info&0xf) == STT_TLS
-			    || ARCH_SYM_REJECT_UND(sym))
-				continue;
-		if (!sym->st_value)
-			if ((sym->st_info&0xf) != STT_TLS)
-				continue;
-		if (!(1<<(sym->st_info&0xf) & OK_TYPES)) continue;
-		if (!(1<<(sym->st_info>>4) & OK_BINDS)) continue;
+		if (!sym || !sym_ok(sym, need_def)) continue;
 		def.sym = sym;
 		def.dso = dso;
 		break;
@@ -344,7 +438,7 @@ static inline struct symdef find_sym2(struct dso *dso, const char *s, int need_d
 
 static struct symdef find_sym(struct dso *dso, const char *s, int need_def)
 {
-	return find_sym2(dso, s, need_def, 0);
+	return find_sym2(dso, s, need_def, 0, 0);
 }
 
 static struct symdef get_lfs64(const char *name)
@@ -376,6 +470,185 @@ nomatch:
 	return (struct symdef){ 0 };
 }
 
+/* The relocation cache, enabled by naming a directory in
+ * LD_RELOC_CACHE, records which definition each symbolic relocation
+ * processed at startup resolved to, as an index into the list of
+ * loaded objects and a symbol index, so that later starts can skip the
+ * symbol lookups. Each set of loaded objects has its own file, named
+ * by a hash of the key it is stored with: the build ids and names of
+ * all loaded objects in load order. A recorded definition is only used
+ * if it has the name being looked up; otherwise the cache is dropped
+ * for the rest of the startup and the file removed, to be recorded
+ * afresh next time. Files without a valid header are never replaced
+ * or removed. */
+
+#define RELOC_CACHE_MAGIC "\x7fmrlc\1\0\0"
+#define RELOC_CACHE_UNDEF ((uint32_t)-1)
+#define RELOC_CACHE_LFS64 ((uint32_t)-2)
+
+struct reloc_cache_hdr {
+	char magic[8];
+	uint32_t id_len, nrec;
+};
+
+struct reloc_cache_rec {
+	uint32_t dso, sym;
+};
+
+enum { RC_OFF, RC_USE, RC_RECORD };
+
+static struct reloc_cache {
+	int mode, stale;
+	struct reloc_cache_rec *rec;
+	size_t nrec, pos;
+	struct dso **dsos;
+	size_t *nsyms, ndsos;
+	unsigned char *id, *map;
+	size_t id_len, map_len;
+	char *path;
+} reloc_cache;
+
+static int reloc_cache_get(const char *name, struct symdef *def)
+{
+	struct reloc_cache_rec *r;
+	struct dso *p;
+
+	if (reloc_cache.mode != RC_USE) return 0;
+	if (reloc_cache.pos < reloc_cache.nrec) {
+		r = reloc_cache.rec + reloc_cache.pos++;
+		if (r->dso == RELOC_CACHE_UNDEF) {
+			*def = (struct symdef){ 0 };
+			return 1;
+		}
+		if (r->dso == RELOC_CACHE_LFS64) {
+			*def = get_lfs64(name);
+			if (def->sym) return 1;
+		} else if (r->dso < reloc_cache.ndsos
+		        && r->sym < reloc_cache.nsyms[r->dso]) {
+			p = reloc_cache.dsos[r->dso];
+			def->dso = p;
+			def->sym = p->syms + r->sym;
+			if (!strcmp(name, p->strings + def->sym->st_name))
+				return 1;
+		}
+	}
+	reloc_cache.mode = RC_OFF;
+	reloc_cache.stale = 1;
+	return 0;
+}
+
+static void reloc_cache_put(const char *name, struct symdef def)
+{
+	struct reloc_cache_rec *r;
+
+	if (reloc_cache.mode != RC_RECORD) return;
+	if (reloc_cache.pos == reloc_cache.nrec) {
+		reloc_cache.mode = RC_OFF;
+		return;
+	}
+	r = reloc_cache.rec + reloc_cache.pos++;
+	if (!def.sym) {
+		r->dso = RELOC_CACHE_UNDEF;
+	} else if (strcmp(name, def.dso->strings + def.sym->st_name)) {
+		r->dso = RELOC_CACHE_LFS64;
+	} else {
+		r->dso = def.dso->reloc_cache_id;
+		r->sym = def.sym - def.dso->syms;
+	}
+}
+
+/* Startup tracing, enabled by LD_TRACE_STARTUP=<fd>, writes one line
+ * per event to the fd, prefixed with the time since the dynamic linker
+ * began stage 3: per-DSO load, relocation and constructor costs, and
+ * the boundaries of the startup phases. */
+
+static long trace_us()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - trace_start.tv_sec) * 1000000
+		+ (t.tv_nsec - trace_start.tv_nsec) / 1000;
+}
+
+static void trace(const char *fmt, ...)
+{
+	char buf[512];
+	va_list ap;
+	long t;
+	int l;
+
+	if (trace_fd < 0) return;
+	t = trace_us();
+	l = snprintf(buf, sizeof buf, "ldso %ld.%06ld ", t/1000000, t%1000000);
+	va_start(ap, fmt);
+	l += vsnprintf(buf+l, sizeof buf - l, fmt, ap);
+	va_end(ap);
+	if (l >= sizeof buf) l = sizeof buf - 1, buf[l-1] = '\n';
+	write(trace_fd, buf, l);
+}
+
+enum { RK_RELATIVE, RK_SYMBOLIC, RK_GOT, RK_PLT, RK_COPY, RK_TLS, RK_CNT };
+static size_t reloc_type_cnt[RK_CNT];
+
+static void count_reloc(int type)
+{
+	switch (type) {
+	case REL_RELATIVE: type = RK_RELATIVE; break;
+	case REL_GOT: type = RK_GOT; break;
+	case REL_PLT: type = RK_PLT; break;
+	case REL_COPY: type = RK_COPY; break;
+	case REL_DTPMOD:
+	case REL_DTPOFF:
+	case REL_TPOFF:
+	case REL_TPOFF_NEG:
+	case REL_TLSDESC: type = RK_TLS; break;
+	default: type = RK_SYMBOLIC;
+	}
+	reloc_type_cnt[type]++;
+}
+
+/* While reloc_all processes a DSO, sym_memo maps each of its symbol
+ * indices to the definition found for it, so that symbols referenced
+ * by several relocations (GOT and PLT slots for the same function,
+ * vtables) are looked up only once per DSO. The state byte records
+ * whether the entry is filled and with which need_def. */
+
+struct sym_memo {
+	struct symdef def;
+	unsigned char state;
+};
+
+static struct sym_memo *sym_memo;
+static size_t sym_memo_cnt;
+static size_t reloc_lookups, reloc_memo_hits;
+
+static struct symdef lookup_reloc_sym(const char *name, int sym_index, int type)
+{
+	struct sym_memo *m = 0;
+	struct symdef def;
+	int need_def = type==REL_PLT;
+
+	if (sym_index < sym_memo_cnt && type != REL_COPY) {
+		m = sym_memo + sym_index;
+		if (m->state == 1+need_def) {
+			reloc_memo_hits++;
+			return m->def;
+		}
+	}
+	if (!reloc_cache_get(name, &def)) {
+		reloc_lookups++;
+		def = find_sym(type==REL_COPY ? head->syms_next : head,
+			name, need_def);
+		if (!def.sym) def = get_lfs64(name);
+		reloc_cache_put(name, def);
+	}
+	if (m) {
+		m->def = def;
+		m->state = 1+need_def;
+	}
+	return def;
+}
+
 static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stride)
 {
 	unsigned char *base = dso->base;
@@ -383,7 +656,6 @@ static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stri
 	char *strings = dso->strings;
 	Sym *sym;
 	const char *name;
-	void *ctx;
 	int type;
 	int sym_index;
 	struct symdef def;
@@ -421,15 +693,17 @@ static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stri
 			addend = *reloc_addr;
 		}
 
+		if (trace_fd >= 0)
+			count_reloc(IS_RELATIVE(rel[1], dso->syms)
+				? REL_RELATIVE : type);
+
 		sym_index = R_SYM(rel[1]);
 		if (sym_index) {
 			sym = syms + sym_index;
 			name = strings + sym->st_name;
-			ctx = type==REL_COPY ? head->syms_next : head;
 			def = (sym->st_info>>4) == STB_LOCAL
 				? (struct symdef){ .dso = dso, .sym = sym }
-				: find_sym(ctx, name, type==REL_PLT);
-			if (!def.sym) def = get_lfs64(name);
+				: lookup_reloc_sym(name, sym_index, type);
 			if (!def.sym && (sym->st_shndx != SHN_UNDEF
 			    || sym->st_info>>4 != STB_WEAK)) {
 				if (dso->lazy && (type==REL_PLT || type==REL_GOT)) {
@@ -560,18 +834,22 @@ static void do_relr_relocs(struct dso *dso, size_t *relr, size_t relr_size)
 {
 	if (dso == &ldso) return; /* self-relocation was done in _dlstart */
 	unsigned char *base = dso->base;
-	size_t *reloc_addr;
+	size_t *reloc_addr, cnt = 0;
 	for (; relr_size; relr++, relr_size-=sizeof(size_t))
 		if ((relr[0]&1) == 0) {
 			reloc_addr = laddr(dso, relr[0]);
 			*reloc_addr++ += (size_t)base;
+			cnt++;
 		} else {
 			int i = 0;
 			for (size_t bitmap=relr[0]; (bitmap>>=1); i++)
-				if (bitmap&1)
+				if (bitmap&1) {
 					reloc_addr[i] += (size_t)base;
+					cnt++;
+				}
 			reloc_addr += 8*sizeof(size_t)-1;
 		}
+	reloc_type_cnt[RK_RELATIVE] += cnt;
 }
 
 static void redo_lazy_relocs()
@@ -641,6 +919,7 @@ static void *mmap_fixed(void *p, size_t n, int prot, int flags, int fd, off_t of
 	static int no_map_fixed;
 	char *q;
 	if (!n) return p;
+	trace_mmaps++;
 	if (!no_map_fixed) {
 		q = mmap(p, n, prot, flags|MAP_FIXED, fd, off);
 		if (!DL_NOMMU_SUPPORT || q != MAP_FAILED || errno != EINVAL)
@@ -681,6 +960,36 @@ static void unmap_library(struct dso *dso)
 	}
 }
 
+/* Starts reading the file contents of the PT_LOAD segments in the
+ * background, so that the I/O overlaps with loading other libraries
+ * rather than being done page by page as relocation touches them. */
+static void readahead_segments(int fd, const Phdr *ph, size_t phnum, size_t phent)
+{
+	size_t lo = SIZE_MAX, hi = 0;
+
+	for (; phnum; phnum--, ph=(void *)((char *)ph+phent)) {
+		if (ph->p_type != PT_LOAD) continue;
+		if (ph->p_offset < lo) lo = ph->p_offset;
+		if (ph->p_offset+ph->p_filesz > hi)
+			hi = ph->p_offset+ph->p_filesz;
+	}
+	lo &= -PAGE_SIZE;
+	if (hi > lo) posix_fadvise(fd, lo, hi-lo, POSIX_FADV_WILLNEED);
+}
+
+static void readahead_library(int fd)
+{
+	Ehdr buf[(896+sizeof(Ehdr))/sizeof(Ehdr)];
+	ssize_t l = pread(fd, buf, sizeof buf, 0);
+
+	if (l < (ssize_t)sizeof *buf || buf->e_phentsize < sizeof(Phdr)
+	    || buf->e_phoff > l
+	    || buf->e_phentsize * buf->e_phnum > l - buf->e_phoff)
+		return;
+	readahead_segments(fd, (void *)((char *)buf + buf->e_phoff),
+		buf->e_phnum, buf->e_phentsize);
+}
+
 static void *map_library(int fd, struct dso *dso)
 {
 	Ehdr buf[(896+sizeof(Ehdr))/sizeof(Ehdr)];
@@ -751,6 +1060,7 @@ static void *map_library(int fd, struct dso *dso)
 		}
 	}
 	if (!dyn) goto noexec;
+	if (load_readahead) readahead_segments(fd, ph0, eh->e_phnum, eh->e_phentsize);
 	if (DL_FDPIC && !(eh->e_flags & FDPIC_CONSTDISP_FLAG)) {
 		dso->loadmap = calloc(1, sizeof *dso->loadmap
 			+ nsegs * sizeof *dso->loadmap->segs);
@@ -761,6 +1071,7 @@ static void *map_library(int fd, struct dso *dso)
 			prot = (((ph->p_flags&PF_R) ? PROT_READ : 0) |
 				((ph->p_flags&PF_W) ? PROT_WRITE: 0) |
 				((ph->p_flags&PF_X) ? PROT_EXEC : 0));
+			trace_mmaps++;
 			map = mmap(0, ph->p_memsz + (ph->p_vaddr & PAGE_SIZE-1),
 				prot, MAP_PRIVATE,
 				fd, ph->p_offset & -PAGE_SIZE);
@@ -800,6 +1111,7 @@ static void *map_library(int fd, struct dso *dso)
 	 * the length of the file. This is okay because we will not
 	 * use the invalid part; we just need to reserve the right
 	 * amount of virtual address space to map over later. */
+	trace_mmaps++;
 	map = DL_NOMMU_SUPPORT
 		? mmap((void *)addr_min, map_len, PROT_READ|PROT_WRITE|PROT_EXEC,
 			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)
@@ -867,6 +1179,105 @@ error:
 	return 0;
 }
 
+/* During startup, directories searched repeatedly for libraries are
+ * listed once and the listing consulted before trying to open a file
+ * there, so that a search over many directories for many libraries
+ * does not cost a failed open for every combination. A directory is
+ * listed on its second search, so programs with few dependencies pay
+ * nothing for it; if it cannot be listed, open is used as before. The
+ * cache is discarded when startup completes, since directories may
+ * change before any later dlopen. */
+
+struct dir_cache {
+	struct dir_cache *next;
+	char **names;
+	size_t cnt;
+	int searches;
+	char dir[];
+};
+
+static struct dir_cache *dir_cache;
+
+static int name_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void list_dir(struct dir_cache *c)
+{
+	char *pool = 0, *tmp, **names;
+	size_t len = 0, cap = 0, cnt = 0, i;
+	struct dirent *de;
+	char buf[2048];
+	int fd, l, off;
+
+	fd = open(c->dir, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	if (fd < 0) return;
+	while ((l = getdents(fd, (void *)buf, sizeof buf)) > 0) {
+		for (off=0; off<l; off+=de->d_reclen) {
+			de = (void *)(buf+off);
+			i = strlen(de->d_name)+1;
+			if (len+i > cap) {
+				cap = 2*cap + i + 1024;
+				if (!(tmp = realloc(pool, cap))) goto fail;
+				pool = tmp;
+			}
+			memcpy(pool+len, de->d_name, i);
+			len += i;
+			cnt++;
+		}
+	}
+	if (l < 0 || !(names = malloc((cnt+1) * sizeof *names))) goto fail;
+	names[cnt] = pool;
+	for (i=0, tmp=pool; i<cnt; i++, tmp+=strlen(tmp)+1)
+		names[i] = tmp;
+	qsort(names, cnt, sizeof *names, name_cmp);
+	c->names = names;
+	c->cnt = cnt;
+fail:
+	if (!c->names) free(pool);
+	close(fd);
+}
+
+static int dir_lacks(const char *dir, size_t l, const char *name)
+{
+	struct dir_cache *c;
+
+	if (runtime) return 0;
+	for (c=dir_cache; c; c=c->next)
+		if (!strncmp(c->dir, dir, l) && c->dir[l]=='/' && !c->dir[l+1])
+			break;
+	if (!c) {
+		if (!(c = malloc(sizeof *c + l + 2))) return 0;
+		memcpy(c->dir, dir, l);
+		c->dir[l] = '/';
+		c->dir[l+1] = 0;
+		c->names = 0;
+		c->cnt = 0;
+		c->searches = 0;
+		c->next = dir_cache;
+		dir_cache = c;
+	}
+	if (!c->names && c->searches++ == 1)
+		list_dir(c);
+	return c->names && !bsearch(&name, c->names, c->cnt,
+		sizeof *c->names, name_cmp);
+}
+
+static void free_dir_cache()
+{
+	struct dir_cache *c, *next;
+	for (c=dir_cache; c; c=next) {
+		next = c->next;
+		if (c->names) {
+			free(c->names[c->cnt]);
+			free(c->names);
+		}
+		free(c);
+	}
+	dir_cache = 0;
+}
+
 static int path_open(const char *name, const char *s, char *buf, size_t buf_size)
 {
 	size_t l;
@@ -875,7 +1286,10 @@ static int path_open(const char *name, const char *s, char *buf, size_t buf_size
 		s += strspn(s, ":\n");
 		l = strcspn(s, ":\n");
 		if (l-1 >= INT_MAX) return -1;
-		if (snprintf(buf, buf_size, "%.*s/%s", (int)l, s, name) < buf_size) {
+		if (dir_lacks(s, l, name)) {
+			/* Not there; same as failing with ENOENT. */
+		} else if (snprintf(buf, buf_size, "%.*s/%s", (int)l, s, name) < buf_size) {
+			trace_opens++;
 			if ((fd = open(buf, O_RDONLY|O_CLOEXEC))>=0) return fd;
 			switch (errno) {
 			case ENOENT:
@@ -893,6 +1307,32 @@ static int path_open(const char *name, const char *s, char *buf, size_t buf_size
 	}
 }
 
+/* The optional index file next to the system path file maps library
+ * names to pathnames, one "name pathname" pair per line, so that the
+ * system path need not be searched for the libraries it lists. Names
+ * not in the index, or whose file cannot be opened, are searched for
+ * on the system path as usual. */
+static int index_open(const char *name, char *buf, size_t buf_size)
+{
+	const char *s = sys_index, *t;
+	size_t n = strlen(name), l;
+	int fd;
+	for (; *s; s += strcspn(s, "\n")) {
+		s += strspn(s, " \t\n");
+		if (strncmp(s, name, n) || (s[n]!=' ' && s[n]!='\t'))
+			continue;
+		t = s + n;
+		t += strspn(t, " \t");
+		l = strcspn(t, " \t\n");
+		if (l-1 >= INT_MAX) continue;
+		if (snprintf(buf, buf_size, "%.*s", (int)l, t) >= buf_size)
+			continue;
+		trace_opens++;
+		if ((fd = open(buf, O_RDONLY|O_CLOEXEC))>=0) return fd;
+	}
+	return -1;
+}
+
 static int fixup_rpath(struct dso *p, char *buf, size_t buf_size)
 {
 	size_t n, l;
@@ -1009,6 +1449,77 @@ static size_t count_syms(struct dso *p)
 	return nsym;
 }
 
+/* Adds the names defined by the objects on the global symbol list
+ * after gsym_tail to the global symbol index, growing it as needed;
+ * on allocation failure the index is dropped and lookups walk the
+ * list. A name already present keeps the definitions found earlier in
+ * the list, except that one seen so far only as an undefined symbol
+ * with a value can still get its need_def definition. */
+static void update_gsym()
+{
+	struct dso *p, *start;
+	struct gsym *tab, *g;
+	size_t n, i, mask, nsym;
+	uint32_t h;
+	Sym *sym, *r;
+	const char *name;
+
+	if (!gsym) {
+		for (n=0, p=head; p && n<GSYM_MIN_DSOS; p=p->syms_next) n++;
+		if (n < GSYM_MIN_DSOS) return;
+		start = head;
+		gsym_cnt = 0;
+	} else {
+		if (gsym_tail == syms_tail) return;
+		start = gsym_tail->syms_next;
+	}
+
+	for (n=gsym_cnt, p=start; p; p=p->syms_next)
+		n += count_syms(p);
+	for (mask=15; mask/2 < n; mask=2*mask+1);
+	if (mask > gsym_mask) {
+		tab = calloc(mask+1, sizeof *tab);
+		if (!tab) {
+			free(gsym);
+			gsym = 0;
+			gsym_mask = 0;
+			return;
+		}
+		if (gsym) for (i=0; i<=gsym_mask; i++)
+			if (gsym[i].name)
+				*gsym_find(tab, mask, gsym[i].name, gsym[i].h) = gsym[i];
+		free(gsym);
+		gsym = tab;
+		gsym_mask = mask;
+	}
+
+	for (p=start; p; p=p->syms_next) {
+		nsym = count_syms(p);
+		i = p->ghashtab ? p->ghashtab[1] : 1;
+		for (sym=p->syms+i; i<nsym; i++, sym++) {
+			if (p->versym && p->versym[i] < 0) continue;
+			if (!sym_ok(sym, 0)) continue;
+			name = p->strings + sym->st_name;
+			h = gnu_hash(name);
+			g = gsym_find(gsym, gsym_mask, name, h);
+			if (g->def.sym) continue;
+			/* Only the symbol a lookup in p would find counts. */
+			r = p->ghashtab ? gnu_lookup(h, p->ghashtab, p, name)
+				: sysv_lookup(name, sysv_hash(name), p);
+			if (!g->name) {
+				if (!sym_ok(r, 0)) continue;
+				g->h = h;
+				g->name = name;
+				g->any = (struct symdef){ .sym = r, .dso = p };
+				gsym_cnt++;
+			}
+			if (sym_ok(r, 1))
+				g->def = (struct symdef){ .sym = r, .dso = p };
+		}
+		gsym_tail = p;
+	}
+}
+
 static void *dl_mmap(size_t n)
 {
 	void *p;
@@ -1049,10 +1560,112 @@ static void makefuncdescs(struct dso *p)
 	}
 }
 
-static struct dso *load_library(const char *name, struct dso *needed_by)
+static const char reserved_libs[] = "c.pthread.rt.m.dl.util.xnet.";
+
+/* Returns the entry in reserved_libs if name is one of the libraries
+ * whose contents are part of libc.so, otherwise 0. */
+static const char *reserved_name(const char *name)
+{
+	const char *rp, *next;
+
+	if (name[0]!='l' || name[1]!='i' || name[2]!='b') return 0;
+	for (rp=reserved_libs; *rp; rp=next) {
+		next = strchr(rp, '.') + 1;
+		if (strncmp(name+3, rp, next-rp) == 0)
+			return rp;
+	}
+	return 0;
+}
+
+/* Searches LD_LIBRARY_PATH, the rpaths of the chain of objects that
+ * needed the library, and the system path for a name without a slash,
+ * and returns an open fd with the pathname in buf, or -1. */
+static int search_library(const char *name, struct dso *needed_by, char *buf, size_t buf_size)
+{
+	struct dso *p;
+	struct stat st;
+	int fd;
+
+	fd = -1;
+	if (env_path) fd = path_open(name, env_path, buf, buf_size);
+	for (p=needed_by; fd == -1 && p; p=p->needed_by) {
+		if (fixup_rpath(p, buf, buf_size) < 0)
+			fd = -2; /* Inhibit further search. */
+		if (p->rpath)
+			fd = path_open(name, p->rpath, buf, buf_size);
+	}
+	if (fd == -1) {
+		if (!sys_path) {
+			char *prefix = 0;
+			size_t prefix_len;
+			if (ldso.name[0]=='/') {
+				char *s, *t, *z;
+				for (s=t=z=ldso.name; *s; s++)
+					if (*s=='/') z=t, t=s;
+				prefix_len = z-ldso.name;
+				if (prefix_len < PATH_MAX)
+					prefix = ldso.name;
+			}
+			if (!prefix) {
+				prefix = "";
+				prefix_len = 0;
+			}
+			char etc_ldso_path[prefix_len + 1
+				+ sizeof "/etc/ld-musl-" LDSO_ARCH ".index"];
+			snprintf(etc_ldso_path, sizeof etc_ldso_path,
+				"%.*s/etc/ld-musl-" LDSO_ARCH ".path",
+				(int)prefix_len, prefix);
+			fd = open(etc_ldso_path, O_RDONLY|O_CLOEXEC);
+			if (fd>=0) {
+				size_t n = 0;
+				if (!fstat(fd, &st)) n = st.st_size;
+				if ((sys_path = malloc(n+1)))
+					sys_path[n] = 0;
+				if (!sys_path || read_loop(fd, sys_path, n)<0) {
+					free(sys_path);
+					sys_path = "";
+				}
+				close(fd);
+			} else if (errno != ENOENT) {
+				sys_path = "";
+			}
+			snprintf(etc_ldso_path, sizeof etc_ldso_path,
+				"%.*s/etc/ld-musl-" LDSO_ARCH ".index",
+				(int)prefix_len, prefix);
+			fd = open(etc_ldso_path, O_RDONLY|O_CLOEXEC);
+			if (fd>=0) {
+				size_t n = 0;
+				if (!fstat(fd, &st)) n = st.st_size;
+				if ((sys_index = malloc(n+1)))
+					sys_index[n] = 0;
+				if (sys_index && read_loop(fd, sys_index, n)<0) {
+					free(sys_index);
+					sys_index = 0;
+				}
+				close(fd);
+			}
+			fd = -1;
+		}
+		if (!sys_path) sys_path = "/lib:/usr/local/lib:/usr/lib";
+		if (sys_index) fd = index_open(name, buf, buf_size);
+		if (fd == -1) fd = path_open(name, sys_path, buf, buf_size);
+	}
+	return fd;
+}
+
+/* A library readahead_deps has already found and opened for
+ * load_library, with the pathname the search resolved and the number
+ * of opens it took. */
+struct opened {
+	int fd;
+	size_t opens;
+	char buf[2*NAME_MAX+2];
+};
+
+static struct dso *load_library(const char *name, struct dso *needed_by, struct opened *o)
 {
 	char buf[2*NAME_MAX+2];
-	const char *pathname;
+	const char *pathname, *rp;
 	unsigned char *map;
 	struct dso *p, temp_dso = {0};
 	int fd;
@@ -1060,37 +1673,30 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 	size_t alloc_size;
 	int n_th = 0;
 	int is_self = 0;
+	long t0 = trace_fd >= 0 ? trace_us() : 0;
 
+	trace_opens = o ? o->opens : 0;
+	trace_mmaps = 0;
 	if (!*name) {
 		errno = EINVAL;
 		return 0;
 	}
 
 	/* Catch and block attempts to reload the implementation itself */
-	if (name[0]=='l' && name[1]=='i' && name[2]=='b') {
-		static const char reserved[] =
-			"c.pthread.rt.m.dl.util.xnet.";
-		const char *rp, *next;
-		for (rp=reserved; *rp; rp=next) {
-			next = strchr(rp, '.') + 1;
-			if (strncmp(name+3, rp, next-rp) == 0)
-				break;
-		}
-		if (*rp) {
-			if (ldd_mode) {
-				/* Track which names have been resolved
-				 * and only report each one once. */
-				static unsigned reported;
-				unsigned mask = 1U<<(rp-reserved);
-				if (!(reported & mask)) {
-					reported |= mask;
-					dprintf(1, "\t%s => %s (%p)\n",
-						name, ldso.name,
-						ldso.base);
-				}
+	if ((rp = reserved_name(name))) {
+		if (ldd_mode) {
+			/* Track which names have been resolved
+			 * and only report each one once. */
+			static unsigned reported;
+			unsigned mask = 1U<<(rp-reserved_libs);
+			if (!(reported & mask)) {
+				reported |= mask;
+				dprintf(1, "\t%s => %s (%p)\n",
+					name, ldso.name,
+					ldso.base);
 			}
-			is_self = 1;
 		}
+		is_self = 1;
 	}
 	if (!strcmp(name, ldso.name)) is_self = 1;
 	if (is_self) {
@@ -1103,63 +1709,28 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 	}
 	if (strchr(name, '/')) {
 		pathname = name;
-		fd = open(name, O_RDONLY|O_CLOEXEC);
+		if (o) {
+			fd = o->fd;
+		} else {
+			trace_opens++;
+			fd = open(name, O_RDONLY|O_CLOEXEC);
+		}
 	} else {
 		/* Search for the name to see if it's already loaded */
 		for (p=head->next; p; p=p->next) {
 			if (p->shortname && !strcmp(p->shortname, name)) {
+				if (o) close(o->fd);
 				return p;
 			}
 		}
 		if (strlen(name) > NAME_MAX) return 0;
-		fd = -1;
-		if (env_path) fd = path_open(name, env_path, buf, sizeof buf);
-		for (p=needed_by; fd == -1 && p; p=p->needed_by) {
-			if (fixup_rpath(p, buf, sizeof buf) < 0)
-				fd = -2; /* Inhibit further search. */
-			if (p->rpath)
-				fd = path_open(name, p->rpath, buf, sizeof buf);
-		}
-		if (fd == -1) {
-			if (!sys_path) {
-				char *prefix = 0;
-				size_t prefix_len;
-				if (ldso.name[0]=='/') {
-					char *s, *t, *z;
-					for (s=t=z=ldso.name; *s; s++)
-						if (*s=='/') z=t, t=s;
-					prefix_len = z-ldso.name;
-					if (prefix_len < PATH_MAX)
-						prefix = ldso.name;
-				}
-				if (!prefix) {
-					prefix = "";
-					prefix_len = 0;
-				}
-				char etc_ldso_path[prefix_len + 1
-					+ sizeof "/etc/ld-musl-" LDSO_ARCH ".path"];
-				snprintf(etc_ldso_path, sizeof etc_ldso_path,
-					"%.*s/etc/ld-musl-" LDSO_ARCH ".path",
-					(int)prefix_len, prefix);
-				fd = open(etc_ldso_path, O_RDONLY|O_CLOEXEC);
-				if (fd>=0) {
-					size_t n = 0;
-					if (!fstat(fd, &st)) n = st.st_size;
-					if ((sys_path = malloc(n+1)))
-						sys_path[n] = 0;
-					if (!sys_path || read_loop(fd, sys_path, n)<0) {
-						free(sys_path);
-						sys_path = "";
-					}
-					close(fd);
-				} else if (errno != ENOENT) {
-					sys_path = "";
-				}
-			}
-			if (!sys_path) sys_path = "/lib:/usr/local/lib:/usr/lib";
-			fd = path_open(name, sys_path, buf, sizeof buf);
+		if (o) {
+			fd = o->fd;
+			pathname = o->buf;
+		} else {
+			fd = search_library(name, needed_by, buf, sizeof buf);
+			pathname = buf;
 		}
-		pathname = buf;
 	}
 	if (fd < 0) return 0;
 	if (fstat(fd, &st) < 0) {
@@ -1189,7 +1760,7 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 	if (find_sym(&temp_dso, "__libc_start_main", 1).sym &&
 	    find_sym(&temp_dso, "stdin", 1).sym) {
 		unmap_library(&temp_dso);
-		return load_library("libc.so", needed_by);
+		return load_library("libc.so", needed_by, 0);
 	}
 	/* Past this point, if we haven't reached runtime yet, ldso has
 	 * committed either to use the mapped library or to abort execution.
@@ -1236,6 +1807,16 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 			& (p->tls.align-1);
 		p->tls.offset = tls_offset;
 #endif
+		/* Modules fitting in the surplus reserved at startup join
+		 * static TLS, as long as all earlier ones did, so that the
+		 * static modules are exactly those numbered up to
+		 * static_tls_cnt. Their alignment cannot exceed that of
+		 * every existing thread's TLS area, since they did not
+		 * raise it. */
+		if (runtime && p->tls_id == static_tls_cnt+1
+		    && p->tls.align <= libc.tls_align
+		    && tls_offset <= static_tls_end)
+			static_tls_cnt = p->tls_id;
 		p->new_dtv = (void *)(-sizeof(size_t) &
 			(uintptr_t)(p->name+strlen(p->name)+sizeof(size_t)));
 		p->new_tls = (void *)(p->new_dtv + n_th*(tls_cnt+1));
@@ -1252,20 +1833,67 @@ static struct dso *load_library(const char *name, struct dso *needed_by)
 
 	if (ldd_mode) dprintf(1, "\t%s => %s (%p)\n", name, pathname, p->base);
 
+	if (trace_fd >= 0)
+		trace("load %s opens=%zu mmaps=%zu us=%ld\n", p->name,
+			trace_opens, trace_mmaps, trace_us() - t0);
+
 	return p;
 }
 
+/* Finds and opens all libraries p needs that are not loaded yet, and
+ * starts their readahead before any of them is mapped, so that their
+ * reads overlap. The open files are kept in o, one per DT_NEEDED entry,
+ * for load_library to map without searching again; entries left with
+ * a negative fd are searched for by load_library as usual. */
+static void readahead_deps(struct dso *p, struct opened *o)
+{
+	const char *name;
+	struct dso *q;
+	size_t i;
+
+	for (i=0; p->dynv[i]; i+=2) {
+		if (p->dynv[i] != DT_NEEDED) continue;
+		o->fd = -1;
+		name = p->strings + p->dynv[i+1];
+		if (!*name || reserved_name(name) || !strcmp(name, ldso.name)) {
+			o++;
+			continue;
+		}
+		trace_opens = 0;
+		if (strchr(name, '/')) {
+			trace_opens++;
+			o->fd = open(name, O_RDONLY|O_CLOEXEC);
+		} else {
+			for (q=head->next; q; q=q->next)
+				if (q->shortname && !strcmp(q->shortname, name))
+					break;
+			if (!q && strlen(name) <= NAME_MAX)
+				o->fd = search_library(name, p, o->buf, sizeof o->buf);
+		}
+		o->opens = trace_opens;
+		if (o->fd >= 0) readahead_library(o->fd);
+		o++;
+	}
+}
+
+static void close_opened(struct opened *o, size_t cnt)
+{
+	for (; cnt; cnt--, o++) if (o->fd >= 0) close(o->fd);
+}
+
 static void load_direct_deps(struct dso *p)
 {
-	size_t i, cnt=0;
+	size_t i, j, cnt=0, ndeps;
+	struct opened *o = 0;
 
 	if (p->deps) return;
 	/* For head, all preloads are direct pseudo-dependencies.
 	 * Count and include them now to avoid realloc later. */
 	if (p==head) for (struct dso *q=p->next; q; q=q->next)
 		cnt++;
-	for (i=0; p->dynv[i]; i+=2)
-		if (p->dynv[i] == DT_NEEDED) cnt++;
+	for (i=0, ndeps=0; p->dynv[i]; i+=2)
+		if (p->dynv[i] == DT_NEEDED) ndeps++;
+	cnt += ndeps;
 	/* Use builtin buffer for apps with no external deps, to
 	 * preserve property of no runtime failure paths. */
 	p->deps = (p==head && cnt<2) ? builtin_deps :
@@ -1274,20 +1902,31 @@ static void load_direct_deps(struct dso *p)
 		error("Error loading dependencies for %s", p->name);
 		if (runtime) longjmp(*rtld_fail, 1);
 	}
+	/* Readahead is only an optimization; without memory for
+	 * the open files, the libraries are just loaded as usual. */
+	if (load_readahead && ndeps && (o = malloc(ndeps * sizeof *o)))
+		readahead_deps(p, o);
 	cnt=0;
 	if (p==head) for (struct dso *q=p->next; q; q=q->next)
 		p->deps[cnt++] = q;
-	for (i=0; p->dynv[i]; i+=2) {
+	for (i=j=0; p->dynv[i]; i+=2) {
 		if (p->dynv[i] != DT_NEEDED) continue;
-		struct dso *dep = load_library(p->strings + p->dynv[i+1], p);
+		struct dso *dep = load_library(p->strings + p->dynv[i+1], p,
+			o && o[j].fd >= 0 ? &o[j] : 0);
+		j++;
 		if (!dep) {
 			error("Error loading shared library %s: %m (needed by %s)",
 				p->strings + p->dynv[i+1], p->name);
-			if (runtime) longjmp(*rtld_fail, 1);
+			if (runtime) {
+				if (o) close_opened(o+j, ndeps-j);
+				free(o);
+				longjmp(*rtld_fail, 1);
+			}
 			continue;
 		}
 		p->deps[cnt++] = dep;
 	}
+	free(o);
 	p->deps[cnt] = 0;
 	p->ndeps_direct = cnt;
 }
@@ -1359,7 +1998,7 @@ static void load_preload(char *s)
 		for (z=s; *z && !isspace(*z) && *z!=':'; z++);
 		tmp = *z;
 		*z = 0;
-		load_library(s, 0);
+		load_library(s, 0, 0);
 		*z = tmp;
 	}
 }
@@ -1407,9 +2046,19 @@ static void do_mips_relocs(struct dso *p, size_t *got)
 static void reloc_all(struct dso *p)
 {
 	size_t dyn[DYN_CNT];
+	long t0;
 	for (; p; p=p->next) {
 		if (p->relocated) continue;
 		decode_vec(p->dynv, dyn, DYN_CNT);
+		/* ldso relocates itself without allocating. */
+		if (p != &ldso) {
+			sym_memo_cnt = count_syms(p);
+			sym_memo = calloc(sym_memo_cnt, sizeof *sym_memo);
+			if (!sym_memo) sym_memo_cnt = 0;
+		}
+		reloc_lookups = reloc_memo_hits = 0;
+		memset(reloc_type_cnt, 0, sizeof reloc_type_cnt);
+		if (trace_fd >= 0) t0 = trace_us();
 		if (NEED_MIPS_GOT_RELOCS)
 			do_mips_relocs(p, laddr(p, dyn[DT_PLTGOT]));
 		do_relocs(p, laddr(p, dyn[DT_JMPREL]), dyn[DT_PLTRELSZ],
@@ -1419,6 +2068,19 @@ static void reloc_all(struct dso *p)
 		if (!DL_FDPIC)
 			do_relr_relocs(p, laddr(p, dyn[DT_RELR]), dyn[DT_RELRSZ]);
 
+		free(sym_memo);
+		sym_memo = 0;
+		sym_memo_cnt = 0;
+		if (trace_fd >= 0)
+			trace("reloc %s relative=%zu symbolic=%zu got=%zu "
+				"plt=%zu copy=%zu tls=%zu lookups=%zu cached=%zu "
+				"us=%ld\n", p->name,
+				reloc_type_cnt[RK_RELATIVE],
+				reloc_type_cnt[RK_SYMBOLIC],
+				reloc_type_cnt[RK_GOT], reloc_type_cnt[RK_PLT],
+				reloc_type_cnt[RK_COPY], reloc_type_cnt[RK_TLS],
+				reloc_lookups, reloc_memo_hits, trace_us() - t0);
+
 		if (head != &ldso && p->relro_start != p->relro_end) {
 			long ret = __syscall(SYS_mprotect, laddr(p, p->relro_start),
 				p->relro_end-p->relro_start, PROT_READ);
@@ -1469,13 +2131,15 @@ void __libc_exit_fini()
 	size_t dyn[DYN_CNT];
 	pthread_t self = __pthread_self();
 
-	/* Take both locks before setting shutting_down, so that
-	 * either lock is sufficient to read its value. The lock
+	/* Take all locks before setting shutting_down, so that
+	 * any one is sufficient to read its value. The lock
 	 * order matches that in dlopen to avoid deadlock. */
+	pthread_mutex_lock(&load_lock);
 	pthread_rwlock_wrlock(&lock);
 	pthread_mutex_lock(&init_fini_lock);
 	shutting_down = 1;
 	pthread_rwlock_unlock(&lock);
+	pthread_mutex_unlock(&load_lock);
 	for (p=fini_head; p; p=p->fini_next) {
 		while (p->ctor_visitor && p->ctor_visitor!=self)
 			pthread_cond_wait(&ctor_cond, &init_fini_lock);
@@ -1496,11 +2160,13 @@ void __libc_exit_fini()
 void __ldso_atfork(int who)
 {
 	if (who<0) {
+		pthread_mutex_lock(&load_lock);
 		pthread_rwlock_wrlock(&lock);
 		pthread_mutex_lock(&init_fini_lock);
 	} else {
 		pthread_mutex_unlock(&init_fini_lock);
 		pthread_rwlock_unlock(&lock);
+		pthread_mutex_unlock(&load_lock);
 	}
 }
 
@@ -1595,6 +2261,7 @@ static void do_init_fini(struct dso **queue)
 
 		pthread_mutex_unlock(&init_fini_lock);
 
+		long t0 = trace_fd >= 0 ? trace_us() : 0;
 #ifndef NO_LEGACY_INITFINI
 		if ((dyn[0] & (1<<DT_INIT)) && dyn[DT_INIT])
 			fpaddr(p, dyn[DT_INIT])();
@@ -1604,6 +2271,8 @@ static void do_init_fini(struct dso **queue)
 			size_t *fn = laddr(p, dyn[DT_INIT_ARRAY]);
 			while (n--) ((void (*)(void))*fn++)();
 		}
+		if (trace_fd >= 0)
+			trace("init %s us=%ld\n", p->name, trace_us() - t0);
 
 		pthread_mutex_lock(&init_fini_lock);
 		p->ctor_visitor = 0;
@@ -1619,6 +2288,7 @@ void __libc_start_init(void)
 	if (!__malloc_replaced && main_ctor_queue != builtin_ctor_queue)
 		free(main_ctor_queue);
 	main_ctor_queue = 0;
+	trace("main\n");
 }
 
 static void dl_debug_state(void)
@@ -1637,7 +2307,7 @@ static void update_tls_size()
 	libc.tls_align = tls_align;
 	libc.tls_size = ALIGN(
 		(1+tls_cnt) * sizeof(void *) +
-		tls_offset +
+		(tls_offset > static_tls_end ? tls_offset : static_tls_end) +
 		sizeof(struct pthread) +
 		tls_align * 2,
 	tls_align);
@@ -1661,9 +2331,29 @@ static void install_new_tls(void)
 			(old_cnt+1)*sizeof(uintptr_t));
 		newdtv[i][0] = tls_cnt;
 	}
-	/* Install new dtls into the enlarged, uninstalled dtv copies. */
+	/* Install new dtls into the enlarged, uninstalled dtv copies.
+	 * Modules in static TLS go at their offset in the space each
+	 * thread already has reserved for them. */
 	for (p=head; ; p=p->next) {
 		if (p->tls_id <= old_cnt) continue;
+		if (p->tls_id <= static_tls_cnt) {
+			for (j=0, td=self; j<i; j++, td=td->next) {
+#ifdef TLS_ABOVE_TP
+				unsigned char *new = (unsigned char *)td
+					+ sizeof(struct pthread) + p->tls.offset;
+#else
+				unsigned char *new = (unsigned char *)td
+					- p->tls.offset;
+#endif
+				memcpy(new, p->tls.image, p->tls.len);
+				memset(new + p->tls.len, 0,
+					p->tls.size - p->tls.len);
+				newdtv[j][p->tls_id] =
+					(uintptr_t)new + DTP_OFFSET;
+			}
+			if (p->tls_id == tls_cnt) break;
+			continue;
+		}
 		unsigned char *mem = p->new_tls;
 		for (j=0; j<i; j++) {
 			unsigned char *new = mem;
@@ -1693,6 +2383,101 @@ static void install_new_tls(void)
 	__restore_sigs(&set);
 }
 
+static int dlfo_cmp(const void *a, const void *b)
+{
+	const struct dlfo_entry *x = a, *y = b;
+	return x->start < y->start ? -1 : x->start > y->start;
+}
+
+/* dlopen loads and relocates new objects holding only load_lock, so
+ * the object list and global symbol list may extend past what readers
+ * should see. Readers walk the lists under the read lock and stop at
+ * pub_tail and pub_syms_tail, which publish() advances with the write
+ * lock held once the new objects are ready. */
+static void publish()
+{
+	struct dso *p;
+	for (p=pub_tail ? pub_tail->next : head; p; p=p->next)
+		p->published = 1;
+	for (p=pub_syms_tail ? pub_syms_tail->syms_next : head; p; p=p->syms_next)
+		p->pub_global = 1;
+	pub_tail = tail;
+	pub_syms_tail = syms_tail;
+}
+
+static struct dso *pub_next(struct dso *p)
+{
+	return p==pub_tail ? 0 : p->next;
+}
+
+/* Publishes the address ranges and unwind segments of all loaded
+ * objects for _dl_find_object, which reads them without locking. The
+ * table in the slot selected by the low bit of dlfo_version is the
+ * current one; a new one is written to the other slot, then the version
+ * is bumped. Readers check the version did not change during their
+ * lookup. A table that has to be replaced by a larger one is retired,
+ * and freed once dlfo_readers shows no lookup in progress, since only
+ * a lookup that had already started can still be looking at it. Called
+ * at startup and with the lock held for writing. */
+static void update_dlfo()
+{
+	int slot = (dlfo_version+1) & 1;
+	struct dlfo_table *t = dlfo_tables[slot], *old = t;
+	struct dso *p;
+	size_t n, cnt;
+
+	if (DL_FDPIC) return;
+	for (cnt=0, p=head; p; p=p->next) cnt++;
+	if (!t || t->cap < cnt) {
+		n = t ? 2*t->cap : 16;
+		if (n < cnt) n = cnt;
+		t = malloc(sizeof *t + n * sizeof *t->e);
+		if (!t) return;
+		t->cap = n;
+		t->cnt = 0;
+		dlfo_tables[slot] = t;
+		if (old) {
+			old->retired = dlfo_retired;
+			dlfo_retired = old;
+		}
+	}
+	/* Readers of the previous version may be looking at this table;
+	 * they find the version changed and retry. */
+	for (n=0, p=head; p; p=p->next, n++) {
+		Phdr *ph = p->phdr;
+		size_t phcnt = p->phnum;
+		size_t lo = -1, hi = 0;
+		t->e[n].eh_frame = 0;
+		t->e[n].eh_size = 0;
+		for (; phcnt--; ph=(void *)((char *)ph+p->phentsize)) {
+			if (ph->p_type == PT_LOAD) {
+				if (ph->p_vaddr < lo) lo = ph->p_vaddr;
+				if (ph->p_vaddr+ph->p_memsz > hi)
+					hi = ph->p_vaddr+ph->p_memsz;
+			} else if (ph->p_type == DLFO_EH_SEGMENT_TYPE) {
+				t->e[n].eh_frame = laddr(p, ph->p_vaddr);
+				t->e[n].eh_size = ph->p_memsz;
+			}
+		}
+		if (lo > hi) lo = hi = 0;
+		t->e[n].start = (size_t)laddr(p, lo & -PAGE_SIZE);
+		t->e[n].end = (size_t)laddr(p, hi);
+		t->e[n].dso = p;
+	}
+	qsort(t->e, n, sizeof *t->e, dlfo_cmp);
+	t->tail = tail;
+	t->cnt = n;
+	a_barrier();
+	dlfo_version++;
+	a_barrier();
+	if (dlfo_retired && !dlfo_readers) {
+		while ((t = dlfo_retired)) {
+			dlfo_retired = t->retired;
+			free(t);
+		}
+	}
+}
+
 /* Stage 1 of the dynamic linker is defined in dlstart.c. It calls the
  * following stage 2 and stage 3 functions via primitive symbolic lookup
  * since it does not have access to their addresses to begin with. */
@@ -1764,6 +2549,163 @@ hidden void __dls2(unsigned char *base, size_t *sp)
 	else ((stage3_func)laddr(&ldso, dls2b_def.sym->st_value))(sp, auxv);
 }
 
+static const unsigned char *find_build_id(struct dso *p, size_t *len)
+{
+	Phdr *ph = p->phdr;
+	size_t cnt = p->phnum;
+	for (; cnt--; ph=(void *)((char *)ph+p->phentsize)) {
+		if (ph->p_type != PT_NOTE) continue;
+		unsigned char *note = laddr(p, ph->p_vaddr);
+		size_t left = ph->p_filesz, namesz, descsz, size;
+		while (left >= 12) {
+			uint32_t *n = (void *)note;
+			namesz = ALIGN((size_t)n[0], 4);
+			descsz = ALIGN((size_t)n[1], 4);
+			if (namesz > left-12 || descsz > left-12-namesz)
+				break;
+			if (n[2] == NT_GNU_BUILD_ID && n[0] == 4
+			    && !memcmp(note+12, "GNU", 4)) {
+				*len = n[1];
+				return note+12+namesz;
+			}
+			size = 12+namesz+descsz;
+			note += size;
+			left -= size;
+		}
+	}
+	return 0;
+}
+
+/* Sets up the relocation cache before the startup relocations: the key
+ * is the sequence of build ids and names of the loaded objects, and if
+ * the file for it matches, its records are used; otherwise a buffer big
+ * enough for every relocation is allocated to record them. Objects
+ * without a build id, or a file in the way that is not a cache file,
+ * leave the cache disabled. */
+static void reloc_cache_open()
+{
+	struct reloc_cache_hdr *hdr;
+	struct dso *p;
+	const unsigned char *bid;
+	size_t dyn[DYN_CNT], n, len, bid_len, name_len, cap, off;
+	unsigned char *id;
+	uint64_t h;
+	struct stat st;
+	int fd;
+
+	for (n=len=cap=0, p=head; p; p=p->next, n++) {
+		if (!(bid = find_build_id(p, &bid_len))) return;
+		len += 2*sizeof(uint32_t) + bid_len;
+		if (p != head) len += strlen(p->name);
+		if (p->relocated) continue;
+		decode_vec(p->dynv, dyn, DYN_CNT);
+		cap += dyn[DT_RELSZ]/(2*sizeof(size_t))
+			+ dyn[DT_RELASZ]/(3*sizeof(size_t))
+			+ dyn[DT_PLTRELSZ]/(2*sizeof(size_t));
+	}
+
+	reloc_cache.id = id = malloc(len);
+	reloc_cache.dsos = malloc(n * sizeof *reloc_cache.dsos);
+	reloc_cache.nsyms = malloc(n * sizeof *reloc_cache.nsyms);
+	if (!id || !reloc_cache.dsos || !reloc_cache.nsyms) return;
+	for (n=0, p=head; p; p=p->next, n++) {
+		bid = find_build_id(p, &bid_len);
+		name_len = p != head ? strlen(p->name) : 0;
+		memcpy(id, &(uint32_t){bid_len}, sizeof(uint32_t));
+		memcpy(id+sizeof(uint32_t), &(uint32_t){name_len}, sizeof(uint32_t));
+		id += 2*sizeof(uint32_t);
+		memcpy(id, bid, bid_len);
+		memcpy(id+bid_len, p->name, name_len);
+		id += bid_len + name_len;
+		p->reloc_cache_id = n;
+		reloc_cache.dsos[n] = p;
+	}
+	reloc_cache.ndsos = n;
+	reloc_cache.id_len = len;
+
+	/* FNV-1a over the key; a collision only costs a re-record,
+	 * since the whole key is checked against the file */
+	for (h=0xcbf29ce484222325, id=reloc_cache.id; id<reloc_cache.id+len; id++)
+		h = (h ^ *id) * 0x100000001b3;
+	n = strlen(env_reloc_cache) + 18;
+	if (!(reloc_cache.path = malloc(n))) return;
+	snprintf(reloc_cache.path, n, "%s/%016llx",
+		env_reloc_cache, (unsigned long long)h);
+
+	fd = open(reloc_cache.path, O_RDONLY|O_CLOEXEC);
+	if (fd >= 0) {
+		off = ALIGN(sizeof *hdr + len, sizeof(uint32_t));
+		if (!fstat(fd, &st) && st.st_size >= sizeof *hdr) {
+			reloc_cache.map_len = st.st_size;
+			reloc_cache.map = mmap(0, st.st_size, PROT_READ,
+				MAP_PRIVATE, fd, 0);
+			if (reloc_cache.map == MAP_FAILED) reloc_cache.map = 0;
+		}
+		close(fd);
+		hdr = (void *)reloc_cache.map;
+		if (!hdr || memcmp(hdr->magic, RELOC_CACHE_MAGIC, 8))
+			return;
+		if (hdr->id_len == len && st.st_size >= off
+		    && !memcmp(hdr+1, reloc_cache.id, len)
+		    && hdr->nrec == (st.st_size - off) / sizeof *reloc_cache.rec) {
+			reloc_cache.rec = (void *)(reloc_cache.map + off);
+			reloc_cache.nrec = hdr->nrec;
+			for (n=0; n<reloc_cache.ndsos; n++)
+				reloc_cache.nsyms[n] = count_syms(reloc_cache.dsos[n]);
+			reloc_cache.mode = RC_USE;
+			return;
+		}
+		reloc_cache.stale = 1;
+	}
+
+	reloc_cache.rec = malloc(cap * sizeof *reloc_cache.rec);
+	if (!reloc_cache.rec) return;
+	reloc_cache.nrec = cap;
+	reloc_cache.mode = RC_RECORD;
+}
+
+/* Writes out what was recorded, via a temporary file renamed into
+ * place, or removes a file found to be stale. */
+static void reloc_cache_close()
+{
+	struct reloc_cache_hdr hdr = { RELOC_CACHE_MAGIC };
+	static const char pad[sizeof(uint32_t)];
+	char tmp[PATH_MAX];
+	size_t padlen;
+	int fd, ok;
+
+	if (reloc_cache.mode == RC_USE && reloc_cache.pos != reloc_cache.nrec)
+		reloc_cache.stale = 1;
+	if (reloc_cache.mode == RC_RECORD && !ldso_fail
+	    && snprintf(tmp, sizeof tmp, "%s.%d", reloc_cache.path,
+	                (int)getpid()) < sizeof tmp
+	    && (fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0600)) >= 0) {
+		hdr.id_len = reloc_cache.id_len;
+		hdr.nrec = reloc_cache.pos;
+		padlen = -(sizeof hdr + hdr.id_len) % sizeof(uint32_t);
+		ok = write(fd, &hdr, sizeof hdr) == sizeof hdr
+			&& write(fd, reloc_cache.id, hdr.id_len) == hdr.id_len
+			&& write(fd, pad, padlen) == padlen
+			&& write(fd, reloc_cache.rec, hdr.nrec * sizeof *reloc_cache.rec)
+				== hdr.nrec * sizeof *reloc_cache.rec;
+		close(fd);
+		if (ok && !rename(tmp, reloc_cache.path))
+			reloc_cache.stale = 0;
+		else
+			unlink(tmp);
+	} else if (reloc_cache.mode != RC_RECORD && reloc_cache.stale) {
+		unlink(reloc_cache.path);
+	}
+
+	if (reloc_cache.map) munmap(reloc_cache.map, reloc_cache.map_len);
+	else free(reloc_cache.rec);
+	free(reloc_cache.id);
+	free(reloc_cache.path);
+	free(reloc_cache.dsos);
+	free(reloc_cache.nsyms);
+	reloc_cache = (struct reloc_cache){ 0 };
+}
+
 /* Stage 2b sets up a valid thread pointer, which requires relocations
  * completed in stage 2, and on which stage 3 is permitted to depend.
  * This is done as a separate stage, with symbolic lookup as a barrier,
@@ -1816,10 +2758,39 @@ void __dls3(size_t *sp, size_t *auxv)
 	libc.secure = ((aux[0]&0x7800)!=0x7800 || aux[AT_UID]!=aux[AT_EUID]
 		|| aux[AT_GID]!=aux[AT_EGID] || aux[AT_SECURE]);
 
+	/* Select per-cpu code paths before doing any real work. */
+	__init_cpu(aux);
+
 	/* Only trust user/env if kernel says we're not suid/sgid */
 	if (!libc.secure) {
 		env_path = getenv("LD_LIBRARY_PATH");
 		env_preload = getenv("LD_PRELOAD");
+		env_reloc_cache = getenv("LD_RELOC_CACHE");
+		load_readahead = getenv("LD_READAHEAD") != 0;
+		env_tls_surplus = getenv("LD_TLS_SURPLUS");
+		char *env_trace = getenv("LD_TRACE_STARTUP"), *end;
+		if (env_trace && *env_trace) {
+			long fd = strtol(env_trace, &end, 10);
+			if (!*end && fd >= 0 && fd <= INT_MAX)
+				trace_fd = fd;
+		} else if (getenv("LD_RELOC_STATS")) {
+			trace_fd = 2;
+		}
+		/* Write to a private copy of the fd, so that the program
+		 * closing and reusing the number does not redirect the
+		 * trace. This also disables tracing if it is not open. The
+		 * copy goes high up, out of the way of the numbers the
+		 * program opens, and never takes the place of a closed
+		 * standard fd. */
+		if (trace_fd >= 0) {
+			int fd = fcntl(trace_fd, F_DUPFD_CLOEXEC, 100);
+			if (fd < 0) fd = fcntl(trace_fd, F_DUPFD_CLOEXEC, 3);
+			trace_fd = fd;
+		}
+		if (trace_fd >= 0) {
+			clock_gettime(CLOCK_MONOTONIC, &trace_start);
+			trace("start %s\n", argv[0]);
+		}
 	}
 
 	/* Activate error handler function */
@@ -1961,6 +2932,7 @@ void __dls3(size_t *sp, size_t *auxv)
  	load_deps(&app);
 	for (struct dso *p=head; p; p=p->next)
 		add_syms(p);
+	trace("loaded\n");
 
 	/* Attach to vdso, if provided by the kernel, last so that it does
 	 * not become part of the global namespace.  */
@@ -2006,6 +2978,20 @@ void __dls3(size_t *sp, size_t *auxv)
 	 * code can see to perform. */
 	main_ctor_queue = queue_ctors(&app);
 
+	update_gsym();
+
+	/* Reserve the requested surplus in every thread's static TLS
+	 * area for modules loaded later by dlopen, aligned enough for
+	 * the alignments such modules commonly need. */
+	if (env_tls_surplus) {
+		size_t surplus = strtoul(env_tls_surplus, 0, 0);
+		if (surplus > TLS_SURPLUS_MAX) surplus = TLS_SURPLUS_MAX;
+		if (surplus) {
+			static_tls_end = tls_offset + surplus;
+			tls_align = MAXP2(tls_align, TLS_SURPLUS_ALIGN);
+		}
+	}
+
 	/* Initial TLS must also be allocated before final relocations
 	 * might result in calloc being a call to application code. */
 	update_tls_size();
@@ -2020,10 +3006,17 @@ void __dls3(size_t *sp, size_t *auxv)
 	}
 	static_tls_cnt = tls_cnt;
 
+	if (env_reloc_cache && !ldd_mode)
+		reloc_cache_open();
+
 	/* The main program must be relocated LAST since it may contain
 	 * copy relocations which depend on libraries' relocations. */
 	reloc_all(app.next);
 	reloc_all(&app);
+	trace("relocated\n");
+
+	if (env_reloc_cache && !ldd_mode)
+		reloc_cache_close();
 
 	/* Actual copying to new TLS needs to happen after relocations,
 	 * since the TLS images might have contained relocated addresses. */
@@ -2057,6 +3050,10 @@ void __dls3(size_t *sp, size_t *auxv)
 	 * linker are a reportable failure rather than a fatal startup
 	 * error. */
 	runtime = 1;
+	free_dir_cache();
+	publish();
+
+	update_dlfo();
 
 	debug.ver = 1;
 	debug.bp = dl_debug_state;
@@ -2069,6 +3066,7 @@ void __dls3(size_t *sp, size_t *auxv)
 
 	errno = 0;
 
+	trace("entry\n");
 	CRTJMP((void *)aux[AT_ENTRY], argv-1);
 	for(;;);
 }
@@ -2099,17 +3097,21 @@ void *dlopen(const char *file, int mode)
 {
 	struct dso *volatile p, *orig_tail, *orig_syms_tail, *orig_lazy_head, *next;
 	struct tls_module *orig_tls_tail;
-	size_t orig_tls_cnt, orig_tls_offset, orig_tls_align;
+	size_t orig_tls_cnt, orig_tls_offset, orig_tls_align, orig_static_tls_cnt;
 	size_t i;
 	int cs;
 	jmp_buf jb;
 	struct dso **volatile ctor_queue = 0;
+	volatile int locked = 0;
 
 	if (!file) return head;
 
+	/* Only publishing the result needs to exclude readers; loading
+	 * is serialized against other dlopen calls by load_lock. */
 	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cs);
-	pthread_rwlock_wrlock(&lock);
+	pthread_mutex_lock(&load_lock);
 	__inhibit_ptc();
+	trace("dlopen %s\n", file);
 
 	debug.state = RT_ADD;
 	_dl_debug_state();
@@ -2123,6 +3125,7 @@ void *dlopen(const char *file, int mode)
 	orig_tls_cnt = tls_cnt;
 	orig_tls_offset = tls_offset;
 	orig_tls_align = tls_align;
+	orig_static_tls_cnt = static_tls_cnt;
 	orig_lazy_head = lazy_head;
 	orig_syms_tail = syms_tail;
 	orig_tail = tail;
@@ -2130,7 +3133,10 @@ void *dlopen(const char *file, int mode)
 
 	rtld_fail = &jb;
 	if (setjmp(*rtld_fail)) {
-		/* Clean up anything new that was (partially) loaded */
+		/* Clean up anything new that was (partially) loaded,
+		 * excluding readers, which may still be following the
+		 * links from published objects being reverted here. */
+		if (!locked) pthread_rwlock_wrlock(&lock);
 		revert_syms(orig_syms_tail);
 		for (p=orig_tail->next; p; p=next) {
 			next = p->next;
@@ -2148,18 +3154,23 @@ void *dlopen(const char *file, int mode)
 		}
 		free(ctor_queue);
 		ctor_queue = 0;
+		free(sym_memo);
+		sym_memo = 0;
+		sym_memo_cnt = 0;
 		if (!orig_tls_tail) libc.tls_head = 0;
 		tls_tail = orig_tls_tail;
 		if (tls_tail) tls_tail->next = 0;
 		tls_cnt = orig_tls_cnt;
 		tls_offset = orig_tls_offset;
 		tls_align = orig_tls_align;
+		static_tls_cnt = orig_static_tls_cnt;
 		lazy_head = orig_lazy_head;
 		tail = orig_tail;
 		tail->next = 0;
+		pthread_rwlock_unlock(&lock);
 		p = 0;
 		goto end;
-	} else p = load_library(file, head);
+	} else p = load_library(file, head, 0);
 
 	if (!p) {
 		error(noload ?
@@ -2171,7 +3182,12 @@ void *dlopen(const char *file, int mode)
 
 	/* First load handling */
 	load_deps(p);
+	/* p may be a published object whose deps readers can search. */
+	pthread_rwlock_wrlock(&lock);
+	locked = 1;
 	extend_bfs_deps(p);
+	locked = 0;
+	pthread_rwlock_unlock(&lock);
 	pthread_mutex_lock(&init_fini_lock);
 	int constructed = p->constructed;
 	pthread_mutex_unlock(&init_fini_lock);
@@ -2199,6 +3215,9 @@ void *dlopen(const char *file, int mode)
 	if (!(mode & RTLD_GLOBAL))
 		revert_syms(orig_syms_tail);
 
+	pthread_rwlock_wrlock(&lock);
+	locked = 1;
+
 	/* Processing of deferred lazy relocations must not happen until
 	 * the new libraries are committed; otherwise we could end up with
 	 * relocations resolved to symbol definitions that get removed. */
@@ -2208,16 +3227,28 @@ void *dlopen(const char *file, int mode)
 	if (tls_cnt != orig_tls_cnt)
 		install_new_tls();
 	orig_tail = tail;
+	publish();
+	update_gsym();
+	gencnt++;
+	if (dso_ranges && dso_ranges->tail != tail) {
+		free(dso_ranges);
+		dso_ranges = 0;
+	}
+	if (!dlfo_tables[dlfo_version & 1]
+	 || dlfo_tables[dlfo_version & 1]->tail != tail)
+		update_dlfo();
+	locked = 0;
+	pthread_rwlock_unlock(&lock);
 end:
 	debug.state = RT_CONSISTENT;
 	_dl_debug_state();
 	__release_ptc();
-	if (p) gencnt++;
-	pthread_rwlock_unlock(&lock);
+	pthread_mutex_unlock(&load_lock);
 	if (ctor_queue) {
 		do_init_fini(ctor_queue);
 		free(ctor_queue);
 	}
+	trace("dlopen %s %s\n", file, p ? "done" : "failed");
 	pthread_setcancelstate(cs, 0);
 	return p;
 }
@@ -2225,21 +3256,73 @@ end:
 hidden int __dl_invalid_handle(void *h)
 {
 	struct dso *p;
-	for (p=head; p; p=p->next) if (h==p) return 0;
+	for (p=head; p; p=pub_next(p)) if (h==p) return 0;
 	error("Invalid library handle %p", (void *)h);
 	return 1;
 }
 
+static int range_cmp(const void *a, const void *b)
+{
+	const struct dso_range *x = a, *y = b;
+	return x->start < y->start ? -1 : x->start > y->start;
+}
+
+/* Returns the PT_LOAD segments of all loaded objects sorted by address,
+ * building the table on first use. Called with the lock held for
+ * reading; dlopen frees the table once it no longer covers every
+ * object. Returns 0 if out of memory. */
+static struct dso_ranges *get_dso_ranges()
+{
+	struct dso_ranges *t = dso_ranges;
+	struct dso *p;
+	size_t n;
+
+	if (t) return t;
+	for (n=0, p=head; p; p=pub_next(p)) n += p->phnum;
+	t = malloc(sizeof *t + n * sizeof *t->r);
+	if (!t) return 0;
+	for (n=0, p=head; p; p=pub_next(p)) {
+		Phdr *ph = p->phdr;
+		size_t phcnt = p->phnum;
+		for (; phcnt--; ph=(void *)((char *)ph+p->phentsize)) {
+			if (ph->p_type != PT_LOAD) continue;
+			t->r[n].start = (size_t)p->base + ph->p_vaddr;
+			t->r[n].len = ph->p_memsz;
+			t->r[n].dso = p;
+			n++;
+		}
+	}
+	t->tail = pub_tail;
+	t->cnt = n;
+	qsort(t->r, n, sizeof *t->r, range_cmp);
+	if (a_cas_p(&dso_ranges, 0, t)) {
+		free(t);
+		t = dso_ranges;
+	}
+	return t;
+}
+
 static void *addr2dso(size_t a)
 {
 	struct dso *p;
-	size_t i;
-	if (DL_FDPIC) for (p=head; p; p=p->next) {
+	struct dso_ranges *t;
+	size_t i, lo, hi;
+	if (DL_FDPIC) for (p=head; p; p=pub_next(p)) {
 		i = count_syms(p);
 		if (a-(size_t)p->funcdescs < i*sizeof(*p->funcdescs))
 			return p;
 	}
-	for (p=head; p; p=p->next) {
+	if (!DL_FDPIC && (t = get_dso_ranges())) {
+		for (lo=0, hi=t->cnt; hi-lo > 1; ) {
+			i = lo + (hi-lo)/2;
+			if (t->r[i].start <= a) lo = i;
+			else hi = i;
+		}
+		if (t->cnt && a-t->r[lo].start < t->r[lo].len)
+			return t->r[lo].dso;
+		return 0;
+	}
+	for (p=head; p; p=pub_next(p)) {
 		if (DL_FDPIC && p->loadmap) {
 			for (i=0; i<p->loadmap->nsegs; i++) {
 				if (a-p->loadmap->segs[i].p_vaddr
@@ -2271,12 +3354,12 @@ static void *do_dlsym(struct dso *p, const char *s, void *ra)
 	} else if (p == RTLD_NEXT) {
 		p = addr2dso((size_t)ra);
 		if (!p) p=head;
-		p = p->next;
+		p = pub_next(p);
 	} else if (__dl_invalid_handle(p)) {
 		return 0;
 	} else
 		use_deps = 1;
-	struct symdef def = find_sym2(p, s, 0, use_deps);
+	struct symdef def = find_sym2(p, s, 0, use_deps, pub_syms_tail);
 	if (!def.sym) {
 		error("Symbol not found: %s", s);
 		return 0;
@@ -2288,18 +3371,68 @@ static void *do_dlsym(struct dso *p, const char *s, void *ra)
 	return laddr(def.dso, def.sym->st_value);
 }
 
+static size_t sym_addr(struct dso *p, uint32_t i)
+{
+	return (size_t)laddr(p, p->syms[i].st_value);
+}
+
+static int sym_addr_cmp(const void *a, const void *b, void *ctx)
+{
+	uint32_t i = *(const uint32_t *)a, j = *(const uint32_t *)b;
+	size_t x = sym_addr(ctx, i), y = sym_addr(ctx, j);
+	if (x != y) return x < y ? -1 : 1;
+	return i < j ? -1 : i > j;
+}
+
+/* Returns the symbols of p that dladdr can report, sorted by address,
+ * keeping only the first in the symbol table of those sharing an
+ * address. The index is built on first use and never changes, since
+ * objects are never unloaded. Returns 0 if out of memory. */
+static struct sym_index *get_sym_index(struct dso *p)
+{
+	struct sym_index *t = p->sym_index;
+	Sym *sym = p->syms;
+	size_t nsym, i, n;
+
+	if (t) return t;
+	nsym = count_syms(p);
+	t = malloc(sizeof *t + nsym * sizeof *t->sym);
+	if (!t) return 0;
+	for (i=n=0; i<nsym; i++) {
+		if (sym[i].st_value
+		 && (1<<(sym[i].st_info&0xf) & OK_TYPES)
+		 && (1<<(sym[i].st_info>>4) & OK_BINDS))
+			t->sym[n++] = i;
+	}
+	qsort_r(t->sym, n, sizeof *t->sym, sym_addr_cmp, p);
+	for (i=nsym=0; i<n; i++) {
+		if (nsym && sym_addr(p, t->sym[i]) == sym_addr(p, t->sym[nsym-1]))
+			continue;
+		t->sym[nsym++] = t->sym[i];
+	}
+	t->cnt = nsym;
+	if (a_cas_p(&p->sym_index, 0, t)) {
+		free(t);
+		t = p->sym_index;
+	}
+	return t;
+}
+
 int dladdr(const void *addr_arg, Dl_info *info)
 {
 	size_t addr = (size_t)addr_arg;
 	struct dso *p;
+	struct sym_index *index;
 	Sym *sym, *bestsym;
 	uint32_t nsym;
 	char *strings;
 	size_t best = 0;
 	size_t besterr = -1;
+	size_t lo, hi, mid;
 
 	pthread_rwlock_rdlock(&lock);
 	p = addr2dso(addr);
+	index = p ? get_sym_index(p) : 0;
 	pthread_rwlock_unlock(&lock);
 
 	if (!p) return 0;
@@ -2318,7 +3451,18 @@ int dladdr(const void *addr_arg, Dl_info *info)
 		}
 	}
 
-	if (!best) for (; nsym; nsym--, sym++) {
+	if (!best && index) {
+		for (lo=0, hi=index->cnt; lo<hi; ) {
+			mid = lo + (hi-lo)/2;
+			if (sym_addr(p, index->sym[mid]) <= addr) lo = mid+1;
+			else hi = mid;
+		}
+		if (lo) {
+			bestsym = sym + index->sym[lo-1];
+			best = sym_addr(p, index->sym[lo-1]);
+			besterr = addr - best;
+		}
+	} else if (!best) for (; nsym; nsym--, sym++) {
 		if (sym->st_value
 		 && (1<<(sym->st_info&0xf) & OK_TYPES)
 		 && (1<<(sym->st_info>>4) & OK_BINDS)) {
@@ -2412,12 +3556,52 @@ int dl_iterate_phdr(int(*callback)(struct dl_phdr_info *info, size_t size, void
 		if (ret != 0) break;
 
 		pthread_rwlock_rdlock(&lock);
-		current = current->next;
+		current = pub_next(current);
 		pthread_rwlock_unlock(&lock);
 	}
 	return ret;
 }
 
+int _dl_find_object(void *pc_arg, struct dl_find_object *result)
+{
+	size_t pc = (size_t)pc_arg, lo, hi, mid;
+	struct dlfo_table *t;
+	struct dlfo_entry e;
+	int v;
+
+	a_inc(&dlfo_readers);
+	do {
+		v = dlfo_version;
+		a_barrier();
+		t = dlfo_tables[v & 1];
+		e.dso = 0;
+		if (t) {
+			for (lo=0, hi=t->cnt; lo<hi; ) {
+				mid = lo + (hi-lo)/2;
+				if (t->e[mid].start <= pc) lo = mid+1;
+				else hi = mid;
+			}
+			if (lo && pc < t->e[lo-1].end) e = t->e[lo-1];
+		}
+		a_barrier();
+	} while (v != dlfo_version);
+	a_dec(&dlfo_readers);
+
+	if (!e.dso) return -1;
+	result->dlfo_flags = 0;
+	result->dlfo_map_start = (void *)e.start;
+	result->dlfo_map_end = (void *)e.end;
+	result->dlfo_link_map = (void *)e.dso;
+	result->dlfo_eh_frame = e.eh_frame;
+#if DLFO_STRUCT_HAS_EH_DBASE
+	result->dlfo_eh_dbase = e.dso->got;
+#endif
+#if DLFO_STRUCT_HAS_EH_COUNT
+	result->dlfo_eh_count = e.eh_size / 8;
+#endif
+	return 0;
+}
+
 static void error_impl(const char *fmt, ...)
 {
 	va_list ap;
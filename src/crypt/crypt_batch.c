@@ -0,0 +1,17 @@
+#include <crypt.h>
+
+/* Equivalent to calling crypt_r on each key and setting with its own
+ * crypt_data, storing the results in out. sha256 and sha512 settings
+ * are hashed several keys at a time where the parameters agree. */
+void crypt_batch(const char *const *keys, const char *const *settings, struct crypt_data *data, char **out, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		out[i] = 0;
+	__crypt_sha256_batch(keys, settings, data, out, n);
+	__crypt_sha512_batch(keys, settings, data, out, n);
+	for (i = 0; i < n; i++)
+		if (!out[i])
+			out[i] = __crypt_r(keys[i], settings[i], data+i);
+}
@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <crypt.h>
 
 /* public domain sha512 implementation based on fips180-3 */
 /* >=2^64 bits messages are not supported (about 2000 peta bytes) */
@@ -205,27 +206,30 @@ static void hashmd(struct sha512 *s, unsigned int n, const void *md)
 	sha512_update(s, md, i);
 }
 
-static char *sha512crypt(const char *key, const char *setting, char *output)
+struct setting {
+	const char *salt;
+	unsigned int klen, slen, r;
+	char rounds[20];
+};
+
+static int parse(struct setting *st, const char *key, const char *setting)
 {
-	struct sha512 ctx;
-	unsigned char md[64], kmd[64], smd[64];
-	unsigned int i, r, klen, slen;
-	char rounds[20] = "";
+	unsigned int i, r, klen;
 	const char *salt;
-	char *p;
 
 	/* reject large keys */
 	for (i = 0; i <= KEY_MAX && key[i]; i++);
 	if (i > KEY_MAX)
-		return 0;
+		return -1;
 	klen = i;
 
 	/* setting: $6$rounds=n$salt$ (rounds=n$ and closing $ are optional) */
 	if (strncmp(setting, "$6$", 3) != 0)
-		return 0;
+		return -1;
 	salt = setting + 3;
 
 	r = ROUNDS_DEFAULT;
+	st->rounds[0] = 0;
 	if (strncmp(salt, "rounds=", sizeof "rounds=" - 1) == 0) {
 		unsigned long u;
 		char *end;
@@ -244,26 +248,38 @@ static char *sha512crypt(const char *key, const char *setting, char *output)
 		 */
 		salt += sizeof "rounds=" - 1;
 		if (!isdigit(*salt))
-			return 0;
+			return -1;
 		u = strtoul(salt, &end, 10);
 		if (*end != '$')
-			return 0;
+			return -1;
 		salt = end+1;
 		if (u < ROUNDS_MIN)
 			r = ROUNDS_MIN;
 		else if (u > ROUNDS_MAX)
-			return 0;
+			return -1;
 		else
 			r = u;
 		/* needed when rounds is zero prefixed or out of bounds */
-		sprintf(rounds, "rounds=%u$", r);
+		sprintf(st->rounds, "rounds=%u$", r);
 	}
 
 	for (i = 0; i < SALT_MAX && salt[i] && salt[i] != '$'; i++)
 		/* reject characters that interfere with /etc/shadow parsing */
 		if (salt[i] == '\n' || salt[i] == ':')
-			return 0;
-	slen = i;
+			return -1;
+	st->salt = salt;
+	st->klen = klen;
+	st->slen = i;
+	st->r = r;
+	return 0;
+}
+
+static void hash(unsigned char *md, const char *key, const struct setting *st)
+{
+	struct sha512 ctx;
+	unsigned char kmd[64], smd[64];
+	unsigned int i, r = st->r, klen = st->klen, slen = st->slen;
+	const char *salt = st->salt;
 
 	/* B = sha(key salt key) */
 	sha512_init(&ctx);
@@ -279,7 +295,7 @@ static char *sha512crypt(const char *key, const char *setting, char *output)
 	hashmd(&ctx, klen, md);
 	for (i = klen; i > 0; i >>= 1)
 		if (i & 1)
-			sha512_update(&ctx, md, sizeof md);
+			sha512_update(&ctx, md, 64);
 		else
 			sha512_update(&ctx, key, klen);
 	sha512_sum(&ctx, md);
@@ -302,21 +318,27 @@ static char *sha512crypt(const char *key, const char *setting, char *output)
 		if (i % 2)
 			hashmd(&ctx, klen, kmd);
 		else
-			sha512_update(&ctx, md, sizeof md);
+			sha512_update(&ctx, md, 64);
 		if (i % 3)
 			sha512_update(&ctx, smd, slen);
 		if (i % 7)
 			hashmd(&ctx, klen, kmd);
 		if (i % 2)
-			sha512_update(&ctx, md, sizeof md);
+			sha512_update(&ctx, md, 64);
 		else
 			hashmd(&ctx, klen, kmd);
 		sha512_sum(&ctx, md);
 	}
+}
+
+static char *format(char *output, const struct setting *st, const unsigned char *md)
+{
+	unsigned int i;
+	char *p;
 
 	/* output is $6$rounds=n$salt$hash */
 	p = output;
-	p += sprintf(p, "$6$%s%.*s$", rounds, slen, salt);
+	p += sprintf(p, "$6$%s%.*s$", st->rounds, st->slen, st->salt);
 #if 1
 	static const unsigned char perm[][3] = {
 		0,21,42,22,43,1,44,2,23,3,24,45,25,46,4,
@@ -354,11 +376,23 @@ static char *sha512crypt(const char *key, const char *setting, char *output)
 	return output;
 }
 
+static char *sha512crypt(const char *key, const char *setting, char *output)
+{
+	struct setting st;
+	unsigned char md[64];
+
+	if (parse(&st, key, setting))
+		return 0;
+	hash(md, key, &st);
+	return format(output, &st, md);
+}
+
+static const char testkey[] = "Xy01@#\x01\x02\x80\x7f\xff\r\n\x81\t !";
+static const char testsetting[] = "$6$rounds=1234$abc0123456789$";
+static const char testhash[] = "$6$rounds=1234$abc0123456789$BCpt8zLrc/RcyuXmCDOE1ALqMXB2MH6n1g891HhFj8.w7LxGv.FTkqq6Vxc/km3Y0jE0j24jY5PIv/oOu6reg1";
+
 char *__crypt_sha512(const char *key, const char *setting, char *output)
 {
-	static const char testkey[] = "Xy01@#\x01\x02\x80\x7f\xff\r\n\x81\t !";
-	static const char testsetting[] = "$6$rounds=1234$abc0123456789$";
-	static const char testhash[] = "$6$rounds=1234$abc0123456789$BCpt8zLrc/RcyuXmCDOE1ALqMXB2MH6n1g891HhFj8.w7LxGv.FTkqq6Vxc/km3Y0jE0j24jY5PIv/oOu6reg1";
 	char testbuf[128];
 	char *p, *q;
 
@@ -369,3 +403,104 @@ char *__crypt_sha512(const char *key, const char *setting, char *output)
 		return "*";
 	return p;
 }
+
+/* short copies for the lanes, cheaper than calls to memcpy */
+static void copy(uint8_t *d, const uint8_t *s, size_t n)
+{
+#ifdef __GNUC__
+	typedef uint64_t __attribute__((__may_alias__, __aligned__(1))) u64;
+	for (; n >= 8; n -= 8, d += 8, s += 8)
+		*(u64 *)d = *(const u64 *)s;
+#endif
+	for (; n; n--)
+		*d++ = *s++;
+}
+
+#define LANES 2
+#define MB(name) name##_lanes
+#include "sha512_lanes.h"
+#undef MB
+
+/* batches are split into groups of up to BATCH_LANES keys with equal
+ * parameters, looking at most BATCH_WINDOW entries ahead */
+#define BATCH_LANES 4
+#define BATCH_WINDOW 64
+
+/* the arrays have BATCH_LANES entries, m of them in use */
+static void hash_group(unsigned char (*md)[64], const char *const *key, const struct setting *const *st, size_t m)
+{
+	size_t i;
+
+#ifdef HASH_GROUP_ARCH
+	if (HASH_GROUP_ARCH(md, key, st, m))
+		return;
+#endif
+	if (m == 1)
+		hash(md[0], key[0], st[0]);
+	else for (i = 0; i < m; i += LANES)
+		hash_lanes(md+i, key+i, st+i);
+}
+
+void __crypt_sha512_batch(const char *const *keys, const char *const *settings, struct crypt_data *data, char **out, size_t n)
+{
+	struct setting st[BATCH_LANES];
+	const struct setting *stp[BATCH_LANES];
+	const char *key[BATCH_LANES];
+	unsigned char md[BATCH_LANES][64];
+	char testbuf[128];
+	size_t idx[BATCH_LANES], i, j, m;
+	int done = 0, small = 0, fail = 0;
+
+	for (i = 0; i < BATCH_LANES; i++)
+		stp[i] = st+i;
+	for (i = 0; i < n; i++) {
+		if (out[i] || strncmp(settings[i], "$6$", 3))
+			continue;
+		for (m = 0, j = i; j < n && j-i < BATCH_WINDOW && m < BATCH_LANES; j++) {
+			if (out[j] || strncmp(settings[j], "$6$", 3))
+				continue;
+			if (parse(st+m, keys[j], settings[j])) {
+				out[j] = "*";
+				continue;
+			}
+			if (m && (st[m].klen != st[0].klen
+			 || st[m].slen != st[0].slen || st[m].r != st[0].r))
+				continue;
+			key[m] = keys[j];
+			idx[m++] = j;
+		}
+		if (!m)
+			continue;
+		for (j = m; j < BATCH_LANES; j++) {
+			st[j] = st[0];
+			key[j] = key[0];
+		}
+		hash_group(md, key, stp, m);
+		for (j = 0; j < m; j++)
+			out[idx[j]] = format((char *)(data+idx[j]), st+j, md[j]);
+		done = 1;
+		small |= m < BATCH_LANES;
+	}
+	if (!done)
+		return;
+
+	/* self test of the lanes and stack cleanup, and of a single
+	 * stream too if smaller groups may have been hashed one key at
+	 * a time, whose frames the lanes do not overwrite */
+	parse(st, testkey, testsetting);
+	for (j = 0; j < BATCH_LANES; j++) {
+		st[j] = st[0];
+		key[j] = testkey;
+	}
+	hash_group(md, key, stp, BATCH_LANES);
+	for (j = 0; j < BATCH_LANES; j++)
+		fail |= memcmp(format(testbuf, st+j, md[j]), testhash, sizeof testhash);
+	if (small) {
+		hash_group(md, key, stp, 1);
+		fail |= memcmp(format(testbuf, st, md[0]), testhash, sizeof testhash);
+	}
+	if (fail)
+		for (i = 0; i < n; i++)
+			if (!strncmp(settings[i], "$6$", 3))
+				out[i] = "*";
+}
@@ -0,0 +1,220 @@
+/* sha256 crypt of LANES keys in lockstep, one key per vector lane.
+ * All lanes share key length, salt length and rounds, so every lane
+ * hashes messages of the same lengths and the block boundaries line
+ * up. Included by crypt_sha256.c with LANES and MB(name) defined, and
+ * possibly several times under different target options. */
+
+typedef uint32_t MB(vec) __attribute__((__vector_size__(4*LANES)));
+
+struct MB(sha256) {
+	uint64_t len;
+	MB(vec) h[8];
+	uint8_t buf[LANES][64];
+};
+
+static void MB(processblock)(struct MB(sha256) *s, const uint8_t *const *p)
+{
+	MB(vec) W[16], t1, t2, a, b, c, d, e, f, g, h;
+	int i, j;
+
+#define ROR(n,k) ((n) >> (k) | (n) << (32-(k)))
+#define VS0(x) (ROR(x,2) ^ ROR(x,13) ^ ROR(x,22))
+#define VS1(x) (ROR(x,6) ^ ROR(x,11) ^ ROR(x,25))
+#define VR0(x) (ROR(x,7) ^ ROR(x,18) ^ (x>>3))
+#define VR1(x) (ROR(x,17) ^ ROR(x,19) ^ (x>>10))
+	for (i = 0; i < 16; i++)
+		for (j = 0; j < LANES; j++)
+			W[i][j] = (uint32_t)p[j][4*i]<<24 | p[j][4*i+1]<<16
+				| p[j][4*i+2]<<8 | p[j][4*i+3];
+	a = s->h[0];
+	b = s->h[1];
+	c = s->h[2];
+	d = s->h[3];
+	e = s->h[4];
+	f = s->h[5];
+	g = s->h[6];
+	h = s->h[7];
+	for (i = 0; i < 64; i++) {
+		if (i >= 16)
+			W[i%16] += VR1(W[(i-2)%16]) + W[(i-7)%16] + VR0(W[(i-15)%16]);
+		t1 = h + VS1(e) + Ch(e,f,g) + K[i] + W[i%16];
+		t2 = VS0(a) + Maj(a,b,c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+#undef ROR
+#undef VS0
+#undef VS1
+#undef VR0
+#undef VR1
+	s->h[0] += a;
+	s->h[1] += b;
+	s->h[2] += c;
+	s->h[3] += d;
+	s->h[4] += e;
+	s->h[5] += f;
+	s->h[6] += g;
+	s->h[7] += h;
+}
+
+static void MB(flush)(struct MB(sha256) *s)
+{
+	const uint8_t *p[LANES];
+	int j;
+
+	for (j = 0; j < LANES; j++)
+		p[j] = s->buf[j];
+	MB(processblock)(s, p);
+}
+
+static void MB(sha256_init)(struct MB(sha256) *s)
+{
+	s->len = 0;
+	s->h[0] = (MB(vec)){0} + 0x6a09e667;
+	s->h[1] = (MB(vec)){0} + 0xbb67ae85;
+	s->h[2] = (MB(vec)){0} + 0x3c6ef372;
+	s->h[3] = (MB(vec)){0} + 0xa54ff53a;
+	s->h[4] = (MB(vec)){0} + 0x510e527f;
+	s->h[5] = (MB(vec)){0} + 0x9b05688c;
+	s->h[6] = (MB(vec)){0} + 0x1f83d9ab;
+	s->h[7] = (MB(vec)){0} + 0x5be0cd19;
+}
+
+static void MB(sha256_sum)(struct MB(sha256) *s, unsigned char (*md)[32])
+{
+	unsigned r = s->len % 64;
+	uint64_t len = s->len * 8;
+	int i, j;
+
+	for (j = 0; j < LANES; j++)
+		s->buf[j][r] = 0x80;
+	if (++r > 56) {
+		for (j = 0; j < LANES; j++)
+			memset(s->buf[j] + r, 0, 64 - r);
+		MB(flush)(s);
+		r = 0;
+	}
+	for (j = 0; j < LANES; j++) {
+		memset(s->buf[j] + r, 0, 56 - r);
+		for (i = 0; i < 8; i++)
+			s->buf[j][56+i] = len >> 56-8*i;
+	}
+	MB(flush)(s);
+	for (j = 0; j < LANES; j++)
+		for (i = 0; i < 8; i++) {
+			md[j][4*i] = s->h[i][j] >> 24;
+			md[j][4*i+1] = s->h[i][j] >> 16;
+			md[j][4*i+2] = s->h[i][j] >> 8;
+			md[j][4*i+3] = s->h[i][j];
+		}
+}
+
+/* Lane j hashes len bytes at m[j]. Whole blocks are read in place. */
+static void MB(sha256_update)(struct MB(sha256) *s, const void *const *m, unsigned long len)
+{
+	const uint8_t *p[LANES];
+	unsigned r = s->len % 64;
+	unsigned long o = 0;
+	int j;
+
+	s->len += len;
+	if (r) {
+		if (len < 64 - r) {
+			for (j = 0; j < LANES; j++)
+				copy(s->buf[j] + r, m[j], len);
+			return;
+		}
+		for (j = 0; j < LANES; j++)
+			copy(s->buf[j] + r, m[j], 64 - r);
+		o = 64 - r;
+		MB(flush)(s);
+	}
+	for (; len - o >= 64; o += 64) {
+		for (j = 0; j < LANES; j++)
+			p[j] = (const uint8_t *)m[j] + o;
+		MB(processblock)(s, p);
+	}
+	for (j = 0; j < LANES; j++)
+		copy(s->buf[j], (const uint8_t *)m[j] + o, len - o);
+}
+
+static void MB(hashmd)(struct MB(sha256) *s, unsigned int n, const void *const *md)
+{
+	unsigned int i;
+
+	for (i = n; i > 32; i -= 32)
+		MB(sha256_update)(s, md, 32);
+	MB(sha256_update)(s, md, i);
+}
+
+/* The same steps as hash(), for the keys and settings of all lanes. */
+static void MB(hash)(unsigned char (*md)[32], const char *const *key, const struct setting *const *st)
+{
+	struct MB(sha256) ctx;
+	unsigned char kmd[LANES][32], smd[LANES][32];
+	const void *k[LANES], *salt[LANES], *mdp[LANES], *kmdp[LANES], *smdp[LANES];
+	unsigned int i, r = st[0]->r, klen = st[0]->klen, slen = st[0]->slen;
+	int j;
+
+	for (j = 0; j < LANES; j++) {
+		k[j] = key[j];
+		salt[j] = st[j]->salt;
+		mdp[j] = md[j];
+		kmdp[j] = kmd[j];
+		smdp[j] = smd[j];
+	}
+
+	MB(sha256_init)(&ctx);
+	MB(sha256_update)(&ctx, k, klen);
+	MB(sha256_update)(&ctx, salt, slen);
+	MB(sha256_update)(&ctx, k, klen);
+	MB(sha256_sum)(&ctx, md);
+
+	MB(sha256_init)(&ctx);
+	MB(sha256_update)(&ctx, k, klen);
+	MB(sha256_update)(&ctx, salt, slen);
+	MB(hashmd)(&ctx, klen, mdp);
+	for (i = klen; i > 0; i >>= 1)
+		if (i & 1)
+			MB(sha256_update)(&ctx, mdp, 32);
+		else
+			MB(sha256_update)(&ctx, k, klen);
+	MB(sha256_sum)(&ctx, md);
+
+	MB(sha256_init)(&ctx);
+	for (i = 0; i < klen; i++)
+		MB(sha256_update)(&ctx, k, klen);
+	MB(sha256_sum)(&ctx, kmd);
+
+	/* the repeat count of DS depends on the lane's digest */
+	for (j = 0; j < LANES; j++) {
+		struct sha256 c;
+		sha256_init(&c);
+		for (i = 0; i < 16 + md[j][0]; i++)
+			sha256_update(&c, salt[j], slen);
+		sha256_sum(&c, smd[j]);
+	}
+
+	for (i = 0; i < r; i++) {
+		MB(sha256_init)(&ctx);
+		if (i % 2)
+			MB(hashmd)(&ctx, klen, kmdp);
+		else
+			MB(sha256_update)(&ctx, mdp, 32);
+		if (i % 3)
+			MB(sha256_update)(&ctx, smdp, slen);
+		if (i % 7)
+			MB(hashmd)(&ctx, klen, kmdp);
+		if (i % 2)
+			MB(sha256_update)(&ctx, mdp, 32);
+		else
+			MB(hashmd)(&ctx, klen, kmdp);
+		MB(sha256_sum)(&ctx, md);
+	}
+}
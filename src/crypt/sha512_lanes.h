@@ -0,0 +1,226 @@
+/* sha512 crypt of LANES keys in lockstep, one key per vector lane.
+ * All lanes share key length, salt length and rounds, so every lane
+ * hashes messages of the same lengths and the block boundaries line
+ * up. Included by crypt_sha512.c with LANES and MB(name) defined, and
+ * possibly several times under different target options. */
+
+typedef uint64_t MB(vec) __attribute__((__vector_size__(8*LANES)));
+
+struct MB(sha512) {
+	uint64_t len;
+	MB(vec) h[8];
+	uint8_t buf[LANES][128];
+};
+
+static void MB(processblock)(struct MB(sha512) *s, const uint8_t *const *p)
+{
+	MB(vec) W[16], t1, t2, a, b, c, d, e, f, g, h;
+	int i, j;
+
+#define ROR(n,k) ((n) >> (k) | (n) << (64-(k)))
+#define VS0(x) (ROR(x,28) ^ ROR(x,34) ^ ROR(x,39))
+#define VS1(x) (ROR(x,14) ^ ROR(x,18) ^ ROR(x,41))
+#define VR0(x) (ROR(x,1) ^ ROR(x,8) ^ (x>>7))
+#define VR1(x) (ROR(x,19) ^ ROR(x,61) ^ (x>>6))
+	for (i = 0; i < 16; i++)
+		for (j = 0; j < LANES; j++)
+			W[i][j] = (uint64_t)p[j][8*i]<<56 | (uint64_t)p[j][8*i+1]<<48
+				| (uint64_t)p[j][8*i+2]<<40 | (uint64_t)p[j][8*i+3]<<32
+				| (uint64_t)p[j][8*i+4]<<24 | p[j][8*i+5]<<16
+				| p[j][8*i+6]<<8 | p[j][8*i+7];
+	a = s->h[0];
+	b = s->h[1];
+	c = s->h[2];
+	d = s->h[3];
+	e = s->h[4];
+	f = s->h[5];
+	g = s->h[6];
+	h = s->h[7];
+	for (i = 0; i < 80; i++) {
+		if (i >= 16)
+			W[i%16] += VR1(W[(i-2)%16]) + W[(i-7)%16] + VR0(W[(i-15)%16]);
+		t1 = h + VS1(e) + Ch(e,f,g) + K[i] + W[i%16];
+		t2 = VS0(a) + Maj(a,b,c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+#undef ROR
+#undef VS0
+#undef VS1
+#undef VR0
+#undef VR1
+	s->h[0] += a;
+	s->h[1] += b;
+	s->h[2] += c;
+	s->h[3] += d;
+	s->h[4] += e;
+	s->h[5] += f;
+	s->h[6] += g;
+	s->h[7] += h;
+}
+
+static void MB(flush)(struct MB(sha512) *s)
+{
+	const uint8_t *p[LANES];
+	int j;
+
+	for (j = 0; j < LANES; j++)
+		p[j] = s->buf[j];
+	MB(processblock)(s, p);
+}
+
+static void MB(sha512_init)(struct MB(sha512) *s)
+{
+	s->len = 0;
+	s->h[0] = (MB(vec)){0} + 0x6a09e667f3bcc908ULL;
+	s->h[1] = (MB(vec)){0} + 0xbb67ae8584caa73bULL;
+	s->h[2] = (MB(vec)){0} + 0x3c6ef372fe94f82bULL;
+	s->h[3] = (MB(vec)){0} + 0xa54ff53a5f1d36f1ULL;
+	s->h[4] = (MB(vec)){0} + 0x510e527fade682d1ULL;
+	s->h[5] = (MB(vec)){0} + 0x9b05688c2b3e6c1fULL;
+	s->h[6] = (MB(vec)){0} + 0x1f83d9abfb41bd6bULL;
+	s->h[7] = (MB(vec)){0} + 0x5be0cd19137e2179ULL;
+}
+
+static void MB(sha512_sum)(struct MB(sha512) *s, unsigned char (*md)[64])
+{
+	unsigned r = s->len % 128;
+	uint64_t len = s->len * 8;
+	int i, j;
+
+	for (j = 0; j < LANES; j++)
+		s->buf[j][r] = 0x80;
+	if (++r > 112) {
+		for (j = 0; j < LANES; j++)
+			memset(s->buf[j] + r, 0, 128 - r);
+		MB(flush)(s);
+		r = 0;
+	}
+	for (j = 0; j < LANES; j++) {
+		memset(s->buf[j] + r, 0, 120 - r);
+		for (i = 0; i < 8; i++)
+			s->buf[j][120+i] = len >> 56-8*i;
+	}
+	MB(flush)(s);
+	for (j = 0; j < LANES; j++)
+		for (i = 0; i < 8; i++) {
+			md[j][8*i] = s->h[i][j] >> 56;
+			md[j][8*i+1] = s->h[i][j] >> 48;
+			md[j][8*i+2] = s->h[i][j] >> 40;
+			md[j][8*i+3] = s->h[i][j] >> 32;
+			md[j][8*i+4] = s->h[i][j] >> 24;
+			md[j][8*i+5] = s->h[i][j] >> 16;
+			md[j][8*i+6] = s->h[i][j] >> 8;
+			md[j][8*i+7] = s->h[i][j];
+		}
+}
+
+/* Lane j hashes len bytes at m[j]. Whole blocks are read in place. */
+static void MB(sha512_update)(struct MB(sha512) *s, const void *const *m, unsigned long len)
+{
+	const uint8_t *p[LANES];
+	unsigned r = s->len % 128;
+	unsigned long o = 0;
+	int j;
+
+	s->len += len;
+	if (r) {
+		if (len < 128 - r) {
+			for (j = 0; j < LANES; j++)
+				copy(s->buf[j] + r, m[j], len);
+			return;
+		}
+		for (j = 0; j < LANES; j++)
+			copy(s->buf[j] + r, m[j], 128 - r);
+		o = 128 - r;
+		MB(flush)(s);
+	}
+	for (; len - o >= 128; o += 128) {
+		for (j = 0; j < LANES; j++)
+			p[j] = (const uint8_t *)m[j] + o;
+		MB(processblock)(s, p);
+	}
+	for (j = 0; j < LANES; j++)
+		copy(s->buf[j], (const uint8_t *)m[j] + o, len - o);
+}
+
+static void MB(hashmd)(struct MB(sha512) *s, unsigned int n, const void *const *md)
+{
+	unsigned int i;
+
+	for (i = n; i > 64; i -= 64)
+		MB(sha512_update)(s, md, 64);
+	MB(sha512_update)(s, md, i);
+}
+
+/* The same steps as hash(), for the keys and settings of all lanes. */
+static void MB(hash)(unsigned char (*md)[64], const char *const *key, const struct setting *const *st)
+{
+	struct MB(sha512) ctx;
+	unsigned char kmd[LANES][64], smd[LANES][64];
+	const void *k[LANES], *salt[LANES], *mdp[LANES], *kmdp[LANES], *smdp[LANES];
+	unsigned int i, r = st[0]->r, klen = st[0]->klen, slen = st[0]->slen;
+	int j;
+
+	for (j = 0; j < LANES; j++) {
+		k[j] = key[j];
+		salt[j] = st[j]->salt;
+		mdp[j] = md[j];
+		kmdp[j] = kmd[j];
+		smdp[j] = smd[j];
+	}
+
+	MB(sha512_init)(&ctx);
+	MB(sha512_update)(&ctx, k, klen);
+	MB(sha512_update)(&ctx, salt, slen);
+	MB(sha512_update)(&ctx, k, klen);
+	MB(sha512_sum)(&ctx, md);
+
+	MB(sha512_init)(&ctx);
+	MB(sha512_update)(&ctx, k, klen);
+	MB(sha512_update)(&ctx, salt, slen);
+	MB(hashmd)(&ctx, klen, mdp);
+	for (i = klen; i > 0; i >>= 1)
+		if (i & 1)
+			MB(sha512_update)(&ctx, mdp, 64);
+		else
+			MB(sha512_update)(&ctx, k, klen);
+	MB(sha512_sum)(&ctx, md);
+
+	MB(sha512_init)(&ctx);
+	for (i = 0; i < klen; i++)
+		MB(sha512_update)(&ctx, k, klen);
+	MB(sha512_sum)(&ctx, kmd);
+
+	/* the repeat count of DS depends on the lane's digest */
+	for (j = 0; j < LANES; j++) {
+		struct sha512 c;
+		sha512_init(&c);
+		for (i = 0; i < 16 + md[j][0]; i++)
+			sha512_update(&c, salt[j], slen);
+		sha512_sum(&c, smd[j]);
+	}
+
+	for (i = 0; i < r; i++) {
+		MB(sha512_init)(&ctx);
+		if (i % 2)
+			MB(hashmd)(&ctx, klen, kmdp);
+		else
+			MB(sha512_update)(&ctx, mdp, 64);
+		if (i % 3)
+			MB(sha512_update)(&ctx, smdp, slen);
+		if (i % 7)
+			MB(hashmd)(&ctx, klen, kmdp);
+		if (i % 2)
+			MB(sha512_update)(&ctx, mdp, 64);
+		else
+			MB(hashmd)(&ctx, klen, kmdp);
+		MB(sha512_sum)(&ctx, md);
+	}
+}
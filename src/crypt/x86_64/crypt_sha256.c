@@ -0,0 +1,103 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "cpu.h"
+
+#if defined(__clang__) || __GNUC__ >= 5
+
+/* the ia32 shuffle builtins used with sha256rnds2 are gcc's */
+#ifndef __clang__
+static int processblock_sha(uint32_t *, const uint8_t *);
+#define PROCESSBLOCK_ARCH processblock_sha
+#endif
+
+struct setting;
+static int hash_group_x86(unsigned char (*)[32], const char *const *, const struct setting *const *, size_t);
+#define HASH_GROUP_ARCH hash_group_x86
+#include "../crypt_sha256.c"
+
+#ifndef __clang__
+
+typedef int v4si __attribute__((__vector_size__(16)));
+typedef long long v2di __attribute__((__vector_size__(16)));
+typedef char v16qi __attribute__((__vector_size__(16)));
+typedef short v8hi __attribute__((__vector_size__(16)));
+
+/* The state is kept as ABEF and CDGH halves for sha256rnds2, which
+ * does two rounds; each iteration does four rounds and extends the
+ * message schedule by four words. */
+__attribute__((__target__("sha,sse4.1")))
+static void processblock_shani(uint32_t *h, const uint8_t *buf)
+{
+	typedef v4si u4si __attribute__((__may_alias__, __aligned__(1)));
+	typedef v16qi u16qi __attribute__((__may_alias__, __aligned__(1)));
+	const v16qi bswap = { 3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12 };
+	v4si w[16], s0, s1, t, m, abef, cdgh;
+	int i;
+
+	t = __builtin_ia32_pshufd(*(const u4si *)h, 0xb1);
+	s1 = __builtin_ia32_pshufd(*(const u4si *)(h+4), 0x1b);
+	s0 = (v4si)__builtin_ia32_palignr128((v2di)t, (v2di)s1, 64);
+	s1 = (v4si)__builtin_ia32_pblendw128((v8hi)s1, (v8hi)t, 0xf0);
+	abef = s0;
+	cdgh = s1;
+	for (i = 0; i < 16; i++) {
+		if (i < 4)
+			w[i] = (v4si)__builtin_ia32_pshufb128(
+				*(const u16qi *)(buf+16*i), bswap);
+		else
+			w[i] = __builtin_ia32_sha256msg2(
+				__builtin_ia32_sha256msg1(w[i-4], w[i-3])
+				+ (v4si)__builtin_ia32_palignr128((v2di)w[i-1], (v2di)w[i-2], 32),
+				w[i-1]);
+		m = w[i] + *(const u4si *)(K+4*i);
+		s1 = __builtin_ia32_sha256rnds2(s1, s0, m);
+		s0 = __builtin_ia32_sha256rnds2(s0, s1, __builtin_ia32_pshufd(m, 0x0e));
+	}
+	s0 += abef;
+	s1 += cdgh;
+	t = __builtin_ia32_pshufd(s0, 0x1b);
+	s1 = __builtin_ia32_pshufd(s1, 0xb1);
+	*(u4si *)h = (v4si)__builtin_ia32_pblendw128((v8hi)t, (v8hi)s1, 0xf0);
+	*(u4si *)(h+4) = (v4si)__builtin_ia32_palignr128((v2di)s1, (v2di)t, 64);
+}
+
+static int processblock_sha(uint32_t *h, const uint8_t *buf)
+{
+	if (!(__cpu_features & CPU_SHA)) return 0;
+	processblock_shani(h, buf);
+	return 1;
+}
+#endif
+
+#undef LANES
+#define LANES 8
+#define MB(name) name##_avx2
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#include "../sha256_lanes.h"
+#pragma GCC pop_options
+#undef MB
+
+static int hash_group_x86(unsigned char (*md)[32], const char *const *key, const struct setting *const *st, size_t m)
+{
+#ifdef PROCESSBLOCK_ARCH
+	/* one stream with sha instructions beats all but nearly full
+	 * groups of avx2 lanes */
+	if ((__cpu_features & CPU_SHA)
+	 && (!(__cpu_features & CPU_AVX2) || m < 6)) {
+		size_t i;
+		for (i = 0; i < m; i++)
+			hash(md[i], key[i], st[i]);
+		return 1;
+	}
+#endif
+	if (!(__cpu_features & CPU_AVX2) || m == 1) return 0;
+	hash_avx2(md, key, st);
+	return 1;
+}
+
+#else
+
+#include "../crypt_sha256.c"
+
+#endif
@@ -0,0 +1,32 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "cpu.h"
+
+#if defined(__clang__) || __GNUC__ >= 5
+
+struct setting;
+static int hash_group_avx2(unsigned char (*)[64], const char *const *, const struct setting *const *, size_t);
+#define HASH_GROUP_ARCH hash_group_avx2
+#include "../crypt_sha512.c"
+
+#undef LANES
+#define LANES 4
+#define MB(name) name##_avx2
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#include "../sha512_lanes.h"
+#pragma GCC pop_options
+#undef MB
+
+static int hash_group_avx2(unsigned char (*md)[64], const char *const *key, const struct setting *const *st, size_t m)
+{
+	if (!(__cpu_features & CPU_AVX2) || m == 1) return 0;
+	hash_avx2(md, key, st);
+	return 1;
+}
+
+#else
+
+#include "../crypt_sha512.c"
+
+#endif
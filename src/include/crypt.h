@@ -13,4 +13,7 @@ hidden char *__crypt_blowfish(const char *, const char *, char *);
 hidden char *__crypt_sha256(const char *, const char *, char *);
 hidden char *__crypt_sha512(const char *, const char *, char *);
 
+hidden void __crypt_sha256_batch(const char *const *, const char *const *, struct crypt_data *, char **, size_t);
+hidden void __crypt_sha512_batch(const char *const *, const char *const *, struct crypt_data *, char **, size_t);
+
 #endif
@@ -0,0 +1,52 @@
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "libc.h"
+
+uint64_t __cpu_features;
+
+#ifndef CPU_DETECT
+static const struct cpu_name {
+	char name[8];
+	uint64_t bit;
+} cpu_names[] = { { "", 0 } };
+
+static uint64_t cpu_detect(size_t *aux)
+{
+	return aux[AT_HWCAP] | (uint64_t)(aux[AT_HWCAP2] & 0xffffffff) << 32;
+}
+#endif
+
+/* MUSL_CPU_FEATURES is a comma-separated list of features to mask off,
+ * each written as -name, or -all for baseline code only. Features can
+ * never be added this way. */
+static uint64_t cpu_mask(const char *s)
+{
+	uint64_t m = -1;
+	const struct cpu_name *p;
+	size_t l;
+	for (; *s; s+=l, s+=!!*s) {
+		l = strcspn(s, ",");
+		if (*s != '-') continue;
+		if (l==4 && !memcmp(s+1, "all", 3)) m = 0;
+		for (p=cpu_names; p->name[0]; p++)
+			if (l-1 == strnlen(p->name, sizeof p->name)
+			 && !memcmp(s+1, p->name, l-1))
+				m &= ~p->bit;
+	}
+	return m;
+}
+
+void __init_cpu(size_t *aux)
+{
+	static int done;
+	char *s;
+	if (done) return;
+	done = 1;
+	uint64_t f = cpu_detect(aux);
+	if (!aux[AT_SECURE] && aux[AT_UID]==aux[AT_EUID]
+	 && aux[AT_GID]==aux[AT_EGID] && (s = getenv("MUSL_CPU_FEATURES")))
+		f &= cpu_mask(s);
+	__cpu_features = f;
+}
@@ -0,0 +1,27 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+#include <features.h>
+
+#ifdef __x86_64__
+#define CPU_SSE41   0x001
+#define CPU_SSE42   0x002
+#define CPU_POPCNT  0x004
+#define CPU_AVX     0x008
+#define CPU_FMA     0x010
+#define CPU_AVX2    0x020
+#define CPU_BMI2    0x040
+#define CPU_ERMS    0x080
+#define CPU_AVX512F 0x100
+#define CPU_SHA     0x200
+#endif
+
+/* Set once by __init_cpu before any application code runs and never
+ * written afterwards. Bits are arch-specific; where the arch does not
+ * provide its own detection they are AT_HWCAP with the low 32 bits of
+ * AT_HWCAP2 above it. A zero value selects baseline code everywhere,
+ * so dispatching functions are safe to call before initialization. */
+extern hidden uint64_t __cpu_features;
+
+#endif
@@ -5,9 +5,11 @@
 #include <limits.h>
 #include <errno.h>
 #include <ctype.h>
+#include <fenv.h>
 
 #include "shgetc.h"
 #include "floatscan.h"
+#include "atomic.h"
 
 #if LDBL_MANT_DIG == 53 && LDBL_MAX_EXP == 1024
 
@@ -33,6 +35,84 @@
 
 #define MASK (KMAX-1)
 
+/* 10^q for q in [-342,308], normalized to 128 bits and rounded down */
+static const uint64_t pow10_128[][2] = {
+#include "pow10_128.h"
+};
+
+static uint64_t mul64(uint64_t *lo, uint64_t x, uint64_t y)
+{
+	uint64_t xl = (uint32_t)x, xh = x>>32;
+	uint64_t yl = (uint32_t)y, yh = y>>32;
+	uint64_t ll = xl*yl, lh = xl*yh, hl = xh*yl, hh = xh*yh;
+	uint64_t mid = (ll>>32) + (uint32_t)lh + (uint32_t)hl;
+	*lo = mid<<32 | (uint32_t)ll;
+	return hh + (lh>>32) + (hl>>32) + (mid>>32);
+}
+
+/* Eisel-Lemire: round w*10^q to a float or double of the given number
+ * of bits using the truncated 128-bit product. Returns 0 if the error
+ * of the approximation could affect rounding, or if the result is
+ * subnormal or overflows; the exact algorithm decides those. It only
+ * rounds to nearest, and the caller applies the sign afterwards, so
+ * other rounding modes are left to the exact algorithm too. */
+int __eisel_lemire(uint64_t w, int q, int bits, double *y)
+{
+	int sh = 62-bits, bias = bits==DBL_MANT_DIG ? 1023 : 127;
+	uint64_t mask = (1ULL<<sh)-1, hi, lo, hi2, lo2, m;
+	int clz, msb, e2;
+
+	if (fegetround() != FE_TONEAREST) return 0;
+
+#if FLT_EVAL_METHOD == 0
+	/* When w and 10^q are both exact a single operation rounds
+	 * correctly; this also covers the short decimals whose truncated
+	 * products are too close to a rounding boundary to decide. */
+	static const double p10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	if (bits==DBL_MANT_DIG && w < 1ULL<<53 && q >= -22 && q <= 22) {
+		*y = q<0 ? w / p10[-q] : w * p10[q];
+		return 1;
+	}
+	if (bits==FLT_MANT_DIG && w < 1U<<24 && q >= -10 && q <= 10) {
+		*y = q<0 ? (float)w / (float)p10[-q] : (float)w * (float)p10[q];
+		return 1;
+	}
+#endif
+
+	if (q < -342 || q > 308) return 0;
+	clz = a_clz_64(w);
+	w <<= clz;
+	hi = mul64(&lo, w, pow10_128[q+342][0]);
+	if ((hi & mask) == mask && lo+w < w) {
+		hi2 = mul64(&lo2, w, pow10_128[q+342][1]);
+		lo += hi2;
+		hi += lo < hi2;
+		if ((hi & mask) == mask && lo+1 == 0 && lo2+w < w)
+			return 0;
+	}
+	msb = hi>>63;
+	m = hi >> msb+sh;
+	e2 = (217706*q>>16) + 64 + bias - clz - (1^msb);
+	if (!lo && !(hi & mask) && (m&3) == 1) return 0;
+	m += m&1;
+	m >>= 1;
+	if (m>>bits) {
+		m >>= 1;
+		e2++;
+	}
+	if (e2 < 1 || e2 > 2*bias) return 0;
+	if (bits==DBL_MANT_DIG) {
+		union { uint64_t i; double f; } u = { (uint64_t)e2<<52 | m & (1ULL<<52)-1 };
+		*y = u.f;
+	} else {
+		union { uint32_t i; float f; } u = { (uint32_t)e2<<23 | m & (1U<<23)-1 };
+		*y = u.f;
+	}
+	return 1;
+}
+
 static long long scanexp(FILE *f, int pok)
 {
 	int c;
@@ -68,6 +148,7 @@ static long double decfloat(FILE *f, int c, int bits, int emin, int sign, int po
 	long long lrp=0, dc=0;
 	long long e10=0;
 	int lnz = 0;
+	uint64_t w = 0;
 	int gotdig = 0, gotrad = 0;
 	int rp;
 	int e2;
@@ -98,6 +179,7 @@ static long double decfloat(FILE *f, int c, int bits, int emin, int sign, int po
 		} else if (k < KMAX-3) {
 			dc++;
 			if (c!='0') lnz = dc;
+			if (dc<=19) w = 10*w + c-'0';
 			if (j) x[k] = x[k]*10 + c-'0';
 			else x[k] = c-'0';
 			if (++j==9) {
@@ -151,6 +233,16 @@ static long double decfloat(FILE *f, int c, int bits, int emin, int sign, int po
 		return sign * LDBL_MIN * LDBL_MIN;
 	}
 
+	/* Decide float and double from the leading 19 digits when possible.
+	 * If more nonzero digits follow, w and w+1 must round the same. */
+	if (bits==DBL_MANT_DIG || bits==FLT_MANT_DIG) {
+		double d, d1;
+		int q = lrp - (dc<19 ? dc : 19);
+		if (__eisel_lemire(w, q, bits, &d)
+		 && (lnz<=19 || __eisel_lemire(w+1, q, bits, &d1) && d1==d))
+			return sign * d;
+	}
+
 	/* Align incomplete final B1B digit */
 	if (j) {
 		for (; j<9; j++) x[k]*=10;
@@ -2,7 +2,9 @@
 #define FLOATSCAN_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 hidden long double __floatscan(FILE *, int, int);
+hidden int __eisel_lemire(uint64_t, int, int, double *);
 
 #endif
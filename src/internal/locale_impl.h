@@ -13,6 +13,7 @@ struct __locale_map {
 	size_t map_size;
 	char name[LOCALE_NAME_MAX+1];
 	const struct __locale_map *next;
+	const void *coll;
 };
 
 extern hidden volatile int __locale_lock[1];
@@ -23,6 +24,9 @@ extern hidden const struct __locale_struct __c_dot_utf8_locale;
 
 hidden const struct __locale_map *__get_locale(int, const char *);
 hidden const char *__mo_lookup(const void *, size_t, const char *);
+hidden const void *__coll_map(const char *, size_t *);
+hidden int __collate(const void *, const void *, int, const void *);
+hidden size_t __collate_key(void *restrict, const void *restrict, size_t, int, const void *);
 hidden const char *__lctrans(const char *, const struct __locale_map *);
 hidden const char *__lctrans_cur(const char *);
 hidden const char *__lctrans_impl(const char *, const struct __locale_map *);
@@ -58,6 +58,13 @@ struct pthread {
 	volatile int killlock[1];
 	char *dlerror_buf;
 	void *stdio_locks;
+	struct {
+		long long lo, hi;
+		long off, oppoff;
+		const char *zone;
+		unsigned gen;
+		int isdst;
+	} tz_cache;
 
 	/* Part 3 -- the positions of these fields relative to
 	 * the end of the structure is external and internal ABI. */
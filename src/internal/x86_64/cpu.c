@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "cpu.h"
+
+#define CPU_DETECT
+
+static const struct cpu_name {
+	char name[8];
+	uint64_t bit;
+} cpu_names[] = {
+	{ "sse4.1", CPU_SSE41 },
+	{ "sse4.2", CPU_SSE42 },
+	{ "popcnt", CPU_POPCNT },
+	{ "avx", CPU_AVX },
+	{ "fma", CPU_FMA },
+	{ "avx2", CPU_AVX2 },
+	{ "bmi2", CPU_BMI2 },
+	{ "erms", CPU_ERMS },
+	{ "avx512f", CPU_AVX512F },
+	{ "sha", CPU_SHA },
+	{ "", 0 }
+};
+
+static void cpuid(unsigned leaf, unsigned *r)
+{
+	__asm__ ("cpuid" : "=a"(r[0]), "=b"(r[1]), "=c"(r[2]), "=d"(r[3])
+		: "a"(leaf), "c"(0));
+}
+
+static uint64_t cpu_detect(size_t *aux)
+{
+	unsigned r[4], max, xcr0 = 0;
+	uint64_t f = 0;
+
+	cpuid(0, r);
+	max = r[0];
+	cpuid(1, r);
+	if (r[2] & 1<<19) f |= CPU_SSE41;
+	if (r[2] & 1<<20) f |= CPU_SSE42;
+	if (r[2] & 1<<23) f |= CPU_POPCNT;
+	/* AVX state must also be enabled by the kernel in XCR0. */
+	if (r[2] & 1<<27)
+		__asm__ ("xgetbv" : "=a"(xcr0) : "c"(0) : "edx");
+	if ((xcr0 & 6) == 6 && (r[2] & 1<<28)) {
+		f |= CPU_AVX;
+		if (r[2] & 1<<12) f |= CPU_FMA;
+	}
+	if (max >= 7) {
+		cpuid(7, r);
+		if (r[1] & 1<<8) f |= CPU_BMI2;
+		if (r[1] & 1<<9) f |= CPU_ERMS;
+		if ((f & CPU_AVX) && (r[1] & 1<<5)) f |= CPU_AVX2;
+		if ((xcr0 & 0xe6) == 0xe6 && (r[1] & 1<<16)) f |= CPU_AVX512F;
+		if ((f & CPU_SSE41) && (r[1] & 1<<29)) f |= CPU_SHA;
+	}
+	return f;
+}
+
+#include "../cpu.c"
@@ -0,0 +1,54 @@
+#define _GNU_SOURCE
+#include <elf.h>
+#include <link.h>
+#include <dlfcn.h>
+#include "libc.h"
+
+#define AUX_CNT 38
+
+extern weak hidden const size_t _DYNAMIC[];
+
+static int static_dl_find_object(void *pc, struct dl_find_object *result)
+{
+	unsigned char *p;
+	ElfW(Phdr) *phdr;
+	size_t base = 0, lo = -1, hi = 0, eh_frame = 0, eh_size = 0;
+	size_t n;
+	size_t i, aux[AUX_CNT] = {0};
+
+	for (i=0; libc.auxv[i]; i+=2)
+		if (libc.auxv[i]<AUX_CNT) aux[libc.auxv[i]] = libc.auxv[i+1];
+
+	for (p=(void *)aux[AT_PHDR],n=aux[AT_PHNUM]; n; n--,p+=aux[AT_PHENT]) {
+		phdr = (void *)p;
+		if (phdr->p_type == PT_PHDR)
+			base = aux[AT_PHDR] - phdr->p_vaddr;
+		if (phdr->p_type == PT_DYNAMIC && _DYNAMIC)
+			base = (size_t)_DYNAMIC - phdr->p_vaddr;
+		if (phdr->p_type == PT_LOAD) {
+			if (phdr->p_vaddr < lo) lo = phdr->p_vaddr;
+			if (phdr->p_vaddr + phdr->p_memsz > hi)
+				hi = phdr->p_vaddr + phdr->p_memsz;
+		}
+		if (phdr->p_type == DLFO_EH_SEGMENT_TYPE) {
+			eh_frame = phdr->p_vaddr;
+			eh_size = phdr->p_memsz;
+		}
+	}
+	lo &= -PAGE_SIZE;
+	if ((size_t)pc - base - lo >= hi - lo) return -1;
+	result->dlfo_flags = 0;
+	result->dlfo_map_start = (void *)(base + lo);
+	result->dlfo_map_end = (void *)(base + hi);
+	result->dlfo_link_map = 0;
+	result->dlfo_eh_frame = eh_frame ? (void *)(base + eh_frame) : 0;
+#if DLFO_STRUCT_HAS_EH_DBASE
+	result->dlfo_eh_dbase = 0;
+#endif
+#if DLFO_STRUCT_HAS_EH_COUNT
+	result->dlfo_eh_count = eh_size / 8;
+#endif
+	return 0;
+}
+
+weak_alias(static_dl_find_object, _dl_find_object);
@@ -0,0 +1,240 @@
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#include <sys/mman.h>
+#include "locale_impl.h"
+
+/* Collation tables are mapped from MUSL_LOCPATH as <locale>.coll,
+ * alongside the locale file itself. They start with the header below,
+ * all fields in native byte order:
+ *
+ * index is the offset of 0x1100 uint16_t page numbers, one for each
+ * block of 256 code points, and pages the offset of npages blocks of
+ * 256 uint32_t entries. An entry is either 0, for code points the
+ * table does not list; a collation element, if the high bit is clear;
+ * or, with the high bit set, a count in bits 24-30 and the index into
+ * the elems array of that many elements (an expansion; a count of 0
+ * makes the character ignorable).
+ *
+ * A collation element holds a 16-bit primary weight in the high half
+ * and 8-bit secondary and tertiary weights below it. A zero weight is
+ * skipped at that level. Nonzero weights may not contain bytes below 2,
+ * so that sort keys can use 1 as level separator, and primaries from
+ * 0xfe00 up are reserved for unlisted code points, which sort after
+ * all listed ones in code point order. Only the first `levels` levels
+ * are compared before the final tie-break on the code points. */
+
+#define COLL_MAGIC 0x636f6c6c
+
+struct coll {
+	uint32_t magic, levels;
+	uint32_t index, pages, npages;
+	uint32_t elems, nelems;
+};
+
+#define INDEX(h) ((const uint16_t *)((const char *)(h) + (h)->index))
+#define PAGES(h) ((const uint32_t *)((const char *)(h) + (h)->pages))
+#define ELEMS(h) ((const uint32_t *)((const char *)(h) + (h)->elems))
+
+static int valid_weights(uint32_t e)
+{
+	unsigned p = e>>16, s = e>>8 & 0xff, t = e & 0xff;
+	return (!p || p>>8 >= 2 && (p&0xff) >= 2 && p < 0xfe00)
+		&& (!s || s >= 2) && (!t || t >= 2);
+}
+
+static int valid(const struct coll *h, size_t size)
+{
+	size_t i;
+	uint32_t e;
+
+	if (size < sizeof *h || h->magic != COLL_MAGIC
+	 || h->levels-1 > 2U || (h->index|h->pages|h->elems) % 4
+	 || h->index + 2*0x1100ULL > size
+	 || h->pages + 1024ULL*h->npages > size
+	 || h->elems + 4ULL*h->nelems > size)
+		return 0;
+	for (i=0; i<0x1100; i++)
+		if (INDEX(h)[i] >= h->npages) return 0;
+	for (i=0; i<256*h->npages; i++) {
+		e = PAGES(h)[i];
+		if (e>>31) {
+			if ((e & 0xffffff) + (e>>24 & 0x7f) > h->nelems) return 0;
+		} else if (!valid_weights(e)) return 0;
+	}
+	for (i=0; i<h->nelems; i++)
+		if (!valid_weights(ELEMS(h)[i])) return 0;
+	return 1;
+}
+
+const void *__coll_map(const char *path, size_t *size)
+{
+	const void *map = __map_file(path, size);
+	if (map && !valid(map, *size)) {
+		__munmap((void *)map, *size);
+		map = 0;
+	}
+	return map;
+}
+
+struct citer {
+	const struct coll *h;
+	const void *s;
+	int wide;
+	const uint32_t *e;
+	size_t n;
+	uint32_t buf[2];
+};
+
+/* Next code point, or 0 at the end of the string. Bytes that are not
+ * part of a valid UTF-8 sequence map to 0xdf80-0xdfff as elsewhere in
+ * musl, so every string has a well-defined order. */
+static unsigned next_char(struct citer *it)
+{
+	unsigned c, d, n, i;
+
+	if (it->wide) {
+		const wchar_t *ws = it->s;
+		if (!*ws) return 0;
+		it->s = ws+1;
+		c = *ws;
+		return c < 0x110000 ? c : 0x110000;
+	}
+
+	const unsigned char *s = it->s;
+	c = *s;
+	if (c < 0x80) {
+		it->s = s + !!c;
+		return c;
+	}
+	if (c-0xc2 <= 0xf4-0xc2) {
+		n = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : 1;
+		d = c & 0x3f>>n;
+		for (i=1; i<=n && s[i]-0x80U < 0x40; i++)
+			d = d<<6 | s[i]-0x80;
+		if (i > n && d >= (n<2 ? 0x80 : n<3 ? 0x800 : 0x10000)
+		 && d-0xd800 >= 0x800 && d < 0x110000) {
+			it->s = s+n+1;
+			return d;
+		}
+	}
+	it->s = s+1;
+	return 0xdfff & (signed char)c;
+}
+
+static void load(struct citer *it, unsigned c)
+{
+	const struct coll *h = it->h;
+	uint32_t e = c < 0x110000 ? PAGES(h)[INDEX(h)[c>>8]*256 + (c&255)] : 0;
+
+	if (!e) {
+		it->buf[0] = 0xfe02 + (c>>14) << 16;
+		it->buf[1] = ((c>>7 & 0x7f) + 2 << 8 | (c & 0x7f) + 2) << 16;
+		it->e = it->buf;
+		it->n = 2;
+	} else if (e>>31) {
+		it->e = ELEMS(h) + (e & 0xffffff);
+		it->n = e>>24 & 0x7f;
+	} else {
+		it->buf[0] = e;
+		it->e = it->buf;
+		it->n = 1;
+	}
+}
+
+/* Next nonzero weight at the given level, or 0 at the end. */
+static unsigned next_weight(struct citer *it, int level)
+{
+	unsigned c, w;
+	for (;;) {
+		while (it->n) {
+			it->n--;
+			w = *it->e++;
+			w = level ? w >> 16-8*level & 0xff : w >> 16;
+			if (w) return w;
+		}
+		if (!(c = next_char(it))) return 0;
+		load(it, c);
+	}
+}
+
+static void start(struct citer *it, const struct coll *h, const void *s, int wide)
+{
+	it->h = h;
+	it->s = s;
+	it->wide = wide;
+	it->n = 0;
+}
+
+int __collate(const void *l, const void *r, int wide, const void *table)
+{
+	const struct coll *h = table;
+	struct citer a, b;
+	unsigned x, y;
+	size_t i = 0;
+	int level;
+
+	/* Each character has the same weights wherever it appears, so a
+	 * common prefix of whole characters never affects the result. */
+	if (wide) {
+		const wchar_t *ws = l, *wr = r;
+		for (; ws[i] == wr[i]; i++) if (!ws[i]) return 0;
+		l = ws+i;
+		r = wr+i;
+	} else {
+		const unsigned char *s = l, *t = r;
+		for (; s[i] == t[i]; i++) if (!s[i]) return 0;
+		while (i && (s[i]-0x80U < 0x40 || t[i]-0x80U < 0x40)) i--;
+		l = s+i;
+		r = t+i;
+	}
+
+	for (level=0; level<h->levels; level++) {
+		start(&a, h, l, wide);
+		start(&b, h, r, wide);
+		do {
+			x = next_weight(&a, level);
+			y = next_weight(&b, level);
+			if (x != y) return x < y ? -1 : 1;
+		} while (x);
+	}
+	return wide ? wcscmp(l, r) : strcmp(l, r);
+}
+
+static void put(void *dest, size_t i, size_t n, int wide, unsigned v)
+{
+	if (i >= n) return;
+	if (wide) ((wchar_t *)dest)[i] = v;
+	else ((unsigned char *)dest)[i] = v;
+}
+
+size_t __collate_key(void *restrict dest, const void *restrict src, size_t n, int wide, const void *table)
+{
+	const struct coll *h = table;
+	struct citer it;
+	unsigned w;
+	size_t i = 0, j;
+	int level;
+
+	/* Weights of each level in turn, primaries as two big-endian
+	 * units, each level ended by 1, then the string itself for the
+	 * final tie-break. Comparing keys with strcmp or wcscmp gives
+	 * the same order as __collate. */
+	for (level=0; level<h->levels; level++) {
+		start(&it, h, src, wide);
+		while ((w = next_weight(&it, level))) {
+			if (!level) put(dest, i++, n, wide, w>>8);
+			put(dest, i++, n, wide, w & 0xff);
+		}
+		put(dest, i++, n, wide, 1);
+	}
+	if (wide) {
+		const wchar_t *ws = src;
+		for (j=0; ws[j]; j++) put(dest, i++, n, wide, ws[j]);
+	} else {
+		const unsigned char *s = src;
+		for (j=0; s[j]; j++) put(dest, i++, n, wide, s[j]);
+	}
+	put(dest, i, n, wide, 0);
+	return i;
+}
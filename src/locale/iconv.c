@@ -19,6 +19,7 @@
 #define UTF_16      0312
 #define UTF_32      0313
 #define UCS2        0314
+#define LATIN_1     0100 /* legacy charmap with no entries */
 #define EUC_JP      0320
 #define SHIFT_JIS   0321
 #define ISO2022_JP  0322
@@ -90,6 +91,11 @@ static const unsigned short rev_jis[] = {
 #include "revjis.h"
 };
 
+/* Start of each 256-codepoint page of the BMP within rev_jis. */
+static const unsigned short rev_jis_page[257] = {
+#include "revjispage.h"
+};
+
 static int fuzzycmp(const unsigned char *a, const unsigned char *b)
 {
 	for (; *a && *b; a++, b++) {
@@ -117,9 +123,20 @@ static size_t find_charmap(const void *name)
 	return -1;
 }
 
+/* Reverse map from code points to bytes for legacy 8-bit targets,
+ * open-addressed by a multiplicative hash and filled on first use. */
+#define REV_SIZE 512
+
+struct revmap {
+	int ready;
+	unsigned short uc[REV_SIZE];
+	unsigned char byte[REV_SIZE];
+};
+
 struct stateful_cd {
 	iconv_t base_cd;
 	unsigned state;
+	struct revmap rev[];
 };
 
 static iconv_t combine_to_from(size_t t, size_t f)
@@ -149,16 +166,21 @@ iconv_t iconv_open(const char *to, const char *from)
 		return (iconv_t)-1;
 	}
 	iconv_t cd = combine_to_from(t, f);
+	int rev = charmaps[t] < 0100, stateful = rev;
 
 	switch (charmaps[f]) {
 	case UTF_16:
 	case UTF_32:
 	case UCS2:
 	case ISO2022_JP:
-		scd = malloc(sizeof *scd);
+		stateful = 1;
+	}
+	if (stateful) {
+		scd = malloc(sizeof *scd + rev * sizeof *scd->rev);
 		if (!scd) return (iconv_t)-1;
 		scd->base_cd = cd;
 		scd->state = 0;
+		if (rev) scd->rev->ready = 0;
 		cd = (iconv_t)scd;
 	}
 
@@ -193,6 +215,250 @@ static void put_32(unsigned char *s, unsigned c, int e)
 	s[e^3] = c;
 }
 
+#define ONES ((size_t)-1/UCHAR_MAX)
+#define HIGHS (ONES * (UCHAR_MAX/2+1))
+
+/* Width of ASCII characters in a target encoding that writes them as
+ * fixed-width code units, or 0 for other encodings. */
+static size_t ascii_width(unsigned totype)
+{
+	switch (totype) {
+	case UTF_8:
+	case US_ASCII:
+	case LATIN_1:
+		return 1;
+	case WCHAR_T:
+		return sizeof(wchar_t);
+	case UTF_32:
+	case UTF_32BE:
+	case UTF_32LE:
+		return 4;
+	case UCS2:
+	case UCS2BE:
+	case UCS2LE:
+	case UTF_16:
+	case UTF_16BE:
+	case UTF_16LE:
+		return 2;
+	}
+	return 0;
+}
+
+/* Convert the run of ASCII, at most n characters, at the start of s
+ * to code units of width w. Returns the number of characters. */
+static size_t ascii_out(const unsigned char *s, size_t n, unsigned char *d, size_t w, unsigned totype)
+{
+	size_t i = 0;
+#ifdef __GNUC__
+	typedef size_t __attribute__((__may_alias__, __aligned__(1))) word;
+#endif
+
+	if (w == 1) {
+#ifdef __GNUC__
+		for (; n-i >= sizeof(size_t) && !(*(word *)(s+i) & HIGHS); i += sizeof(size_t))
+			*(word *)(d+i) = *(word *)(s+i);
+#endif
+		for (; i<n && s[i]<128; i++) d[i] = s[i];
+		return i;
+	}
+#ifdef __GNUC__
+	for (; n-i >= sizeof(size_t) && !(*(word *)(s+i) & HIGHS); i += sizeof(size_t));
+#endif
+	for (; i<n && s[i]<128; i++);
+	n = i;
+	if (totype == WCHAR_T)
+		for (i=0; i<n; i++) ((wchar_t *)d)[i] = s[i];
+	else if (w == 4)
+		for (i=0; i<n; i++) put_32(d+4*i, s[i], totype==UTF_32 ? UTF_32BE : totype);
+	else
+		for (i=0; i<n; i++) put_16(d+2*i, s[i], totype);
+	return n;
+}
+
+/* Bulk conversion between UTF-8 and the fixed-width Unicode encodings
+ * or Latin-1, chosen once per call instead of dispatching on both
+ * encodings for every character. These stop at anything they do not
+ * handle (invalid or partial input, a character the target cannot
+ * represent, a full output buffer) and leave it to the general loop,
+ * so errors are reported exactly as before. */
+
+static int bulk_ok(unsigned type, unsigned totype)
+{
+	if (type == UTF_8) return ascii_width(totype) != 0;
+	if (totype != UTF_8) return 0;
+	switch (type) {
+	case LATIN_1:
+	case WCHAR_T:
+	case UTF_32BE:
+	case UTF_32LE:
+	case UTF_16BE:
+	case UTF_16LE:
+		return 1;
+	}
+	return 0;
+}
+
+static void from_utf8(char **in, size_t *inb, char **out, size_t *outb, unsigned totype)
+{
+	const unsigned char *s = (void *)*in, *e = s + *inb;
+	unsigned char *d = (void *)*out, *de = d + *outb;
+	size_t w = ascii_width(totype), k, l;
+	unsigned c;
+
+	while (s < e) {
+		c = *s;
+		if (c < 0x80) {
+			k = e-s < (de-d)/w ? e-s : (de-d)/w;
+			if (!(k = ascii_out(s, k, d, w, totype))) break;
+			s += k;
+			d += k*w;
+			continue;
+		}
+		if (c-0xc2 <= 0xdf-0xc2) {
+			if (e-s < 2 || s[1]-0x80u >= 0x40) break;
+			c = (c&0x1f)<<6 | s[1]-0x80;
+			l = 2;
+		} else if (c-0xe0 <= 0xef-0xe0) {
+			if (e-s < 3 || s[1]-0x80u >= 0x40 || s[2]-0x80u >= 0x40) break;
+			c = (c&0x0f)<<12 | (s[1]-0x80)<<6 | s[2]-0x80;
+			if (c < 0x800 || c-0xd800 < 0x800) break;
+			l = 3;
+		} else if (c-0xf0 <= 0xf4-0xf0) {
+			if (e-s < 4 || s[1]-0x80u >= 0x40 || s[2]-0x80u >= 0x40
+			 || s[3]-0x80u >= 0x40) break;
+			c = (c&0x07)<<18 | (s[1]-0x80)<<12 | (s[2]-0x80)<<6 | s[3]-0x80;
+			if (c-0x10000 >= 0x100000) break;
+			l = 4;
+		} else break;
+
+		switch (totype) {
+		case UTF_8:
+			if (de-d < l) goto done;
+			d[0] = s[0];
+			d[1] = s[1];
+			if (l > 2) d[2] = s[2];
+			if (l > 3) d[3] = s[3];
+			k = l;
+			break;
+		case LATIN_1:
+			if (c > 0xff || d == de) goto done;
+			*d = c;
+			k = 1;
+			break;
+		case WCHAR_T:
+			if (de-d < sizeof(wchar_t)) goto done;
+			*(wchar_t *)d = c;
+			k = sizeof(wchar_t);
+			break;
+		case UTF_32:
+		case UTF_32BE:
+		case UTF_32LE:
+			if (de-d < 4) goto done;
+			put_32(d, c, totype==UTF_32 ? UTF_32BE : totype);
+			k = 4;
+			break;
+		case UCS2:
+		case UCS2BE:
+		case UCS2LE:
+			if (c >= 0x10000) goto done;
+		case UTF_16:
+		case UTF_16BE:
+		case UTF_16LE:
+			if (c < 0x10000) {
+				if (de-d < 2) goto done;
+				put_16(d, c, totype);
+				k = 2;
+				break;
+			}
+			if (de-d < 4) goto done;
+			c -= 0x10000;
+			put_16(d, (c>>10)|0xd800, totype);
+			put_16(d+2, (c&0x3ff)|0xdc00, totype);
+			k = 4;
+			break;
+		default:
+			goto done;
+		}
+		s += l;
+		d += k;
+	}
+done:
+	*inb -= s - (unsigned char *)*in;
+	*outb -= d - (unsigned char *)*out;
+	*in = (char *)s;
+	*out = (char *)d;
+}
+
+static void to_utf8(char **in, size_t *inb, char **out, size_t *outb, unsigned type)
+{
+	const unsigned char *s = (void *)*in, *e = s + *inb;
+	unsigned char *d = (void *)*out, *de = d + *outb;
+	size_t l;
+	unsigned c, c2;
+
+	while (s < e) {
+		switch (type) {
+		case LATIN_1:
+			c = *s;
+			l = 1;
+			break;
+		case WCHAR_T:
+			if (e-s < sizeof(wchar_t)) goto done;
+			c = *(wchar_t *)s;
+			l = sizeof(wchar_t);
+			if (c-0xd800u < 0x800u || c >= 0x110000u) goto done;
+			break;
+		case UTF_32BE:
+		case UTF_32LE:
+			if (e-s < 4) goto done;
+			c = get_32(s, type);
+			l = 4;
+			if (c-0xd800u < 0x800u || c >= 0x110000u) goto done;
+			break;
+		case UTF_16BE:
+		case UTF_16LE:
+			if (e-s < 2) goto done;
+			c = get_16(s, type);
+			l = 2;
+			if (c-0xd800u < 0x800u) {
+				if (c >= 0xdc00 || e-s < 4) goto done;
+				c2 = get_16(s+2, type);
+				if (c2-0xdc00u >= 0x400u) goto done;
+				c = (c-0xd7c0<<10) + (c2-0xdc00);
+				l = 4;
+			}
+			break;
+		default:
+			goto done;
+		}
+		if (c < 0x80) {
+			if (d == de) goto done;
+			*d++ = c;
+		} else if (c < 0x800) {
+			if (de-d < 2) goto done;
+			*d++ = 0xc0 | c>>6;
+			*d++ = 0x80 | c&0x3f;
+		} else if (c < 0x10000) {
+			if (de-d < 3) goto done;
+			*d++ = 0xe0 | c>>12;
+			*d++ = 0x80 | c>>6&0x3f;
+			*d++ = 0x80 | c&0x3f;
+		} else {
+			if (de-d < 4) goto done;
+			*d++ = 0xf0 | c>>18;
+			*d++ = 0x80 | c>>12&0x3f;
+			*d++ = 0x80 | c>>6&0x3f;
+			*d++ = 0x80 | c&0x3f;
+		}
+		s += l;
+	}
+done:
+	*inb -= s - (unsigned char *)*in;
+	*outb -= d - (unsigned char *)*out;
+	*in = (char *)s;
+	*out = (char *)d;
+}
+
 /* Adapt as needed */
 #define mbrtowc_utf8 mbrtowc
 #define wctomb_utf8 wctomb
@@ -205,10 +471,35 @@ static unsigned legacy_map(const unsigned char *map, unsigned c)
 	return x < 256 ? x : legacy_chars[x-256];
 }
 
+static unsigned rev_hash(unsigned c)
+{
+	return c * 2654435761U >> 23;
+}
+
+static void rev_init(struct revmap *r, const unsigned char *map)
+{
+	unsigned c, u, i;
+	memset(r->uc, 0, sizeof r->uc);
+	/* Filling in increasing byte order keeps the lowest byte for
+	 * code points that appear more than once. */
+	for (c=4*map[-1]; c<256; c++) {
+		if (!(u = legacy_map(map, c))) continue;
+		for (i=rev_hash(u); r->uc[i] && r->uc[i]!=u; i=(i+1)%REV_SIZE);
+		if (!r->uc[i]) {
+			r->uc[i] = u;
+			r->byte[i] = c;
+		}
+	}
+	r->ready = 1;
+}
+
 static unsigned uni_to_jis(unsigned c)
 {
-	unsigned nel = sizeof rev_jis / sizeof *rev_jis;
-	unsigned d, j, i, b = 0;
+	if (c >= 0x10000) return 0;
+	unsigned b = rev_jis_page[c>>8];
+	unsigned nel = rev_jis_page[(c>>8)+1] - b;
+	unsigned d, j, i;
+	if (!nel) return 0;
 	for (;;) {
 		i = nel/2;
 		j = rev_jis[b+i];
@@ -240,7 +531,7 @@ size_t iconv(iconv_t cd, char **restrict in, size_t *restrict inb, char **restri
 	wchar_t wc;
 	unsigned c, d;
 	size_t k, l;
-	int err;
+	int err, bulk;
 	unsigned char type = map[-1];
 	unsigned char totype = tomap[-1];
 	locale_t *ploc = &CURRENT_LOCALE, loc = *ploc;
@@ -249,7 +540,14 @@ size_t iconv(iconv_t cd, char **restrict in, size_t *restrict inb, char **restri
 
 	*ploc = UTF8_LOCALE;
 
+	bulk = bulk_ok(type, totype);
+
 	for (; *inb; *in+=l, *inb-=l) {
+		if (bulk) {
+			if (type == UTF_8) from_utf8(in, inb, out, outb, totype);
+			else to_utf8(in, inb, out, outb, type);
+			if (!*inb) break;
+		}
 		c = *(unsigned char *)*in;
 		l = 1;
 
@@ -307,6 +605,7 @@ size_t iconv(iconv_t cd, char **restrict in, size_t *restrict inb, char **restri
 					l = 2;
 			}
 			type = scd->state;
+			bulk = bulk_ok(type, totype);
 			continue;
 		case UTF_32:
 			l = 0;
@@ -318,6 +617,7 @@ size_t iconv(iconv_t cd, char **restrict in, size_t *restrict inb, char **restri
 					l = 4;
 			}
 			type = scd->state;
+			bulk = bulk_ok(type, totype);
 			continue;
 		case SHIFT_JIS:
 			if (c < 128) break;
@@ -557,10 +857,14 @@ size_t iconv(iconv_t cd, char **restrict in, size_t *restrict inb, char **restri
 				*outb -= 1;
 				break;
 			}
-			d = c;
-			for (c=4*totype; c<256; c++) {
-				if (d == legacy_map(tomap, c)) {
-					goto revout;
+			if (totype < 0100 && c < 0x10000) {
+				struct revmap *r = scd->rev;
+				if (!r->ready) rev_init(r, tomap);
+				for (k=rev_hash(c); r->uc[k]; k=(k+1)%REV_SIZE) {
+					if (r->uc[k] == c) {
+						c = r->byte[k];
+						goto revout;
+					}
 				}
 			}
 			goto subst;
@@ -19,6 +19,13 @@ const char *__lctrans_impl(const char *msg, const struct __locale_map *lm)
 	return trans ? trans : msg;
 }
 
+static const void *dummy_coll_map(const char *path, size_t *size)
+{
+	return 0;
+}
+
+weak_alias(dummy_coll_map, __coll_map);
+
 static const char envvars[][12] = {
 	"LC_CTYPE",
 	"LC_NUMERIC",
@@ -66,6 +73,11 @@ const struct __locale_map *__get_locale(int cat, const char *val)
 	if (!libc.secure) path = getenv("MUSL_LOCPATH");
 	/* FIXME: add a default path? */
 
+	/* Collation tables are only looked for when the collation
+	 * functions are linked, as <locale>.coll next to the locale.
+	 * Both come from the first directory that has either. */
+	const void *map = 0, *coll = 0;
+	size_t map_size, coll_size;
 	if (path) for (; *path; path=z+!!*z) {
 		z = __strchrnul(path, ':');
 		l = z - path;
@@ -74,31 +86,32 @@ const struct __locale_map *__get_locale(int cat, const char *val)
 		buf[l] = '/';
 		memcpy(buf+l+1, val, n);
 		buf[l+1+n] = 0;
-		size_t map_size;
-		const void *map = __map_file(buf, &map_size);
-		if (map) {
-			new = malloc(sizeof *new);
-			if (!new) {
-				__munmap((void *)map, map_size);
-				break;
-			}
-			new->map = map;
-			new->map_size = map_size;
-			memcpy(new->name, val, n);
-			new->name[n] = 0;
-			new->next = loc_head;
-			loc_head = new;
-			break;
+		map = __map_file(buf, &map_size);
+		if (l+n+7 <= sizeof buf) {
+			memcpy(buf+l+1+n, ".coll", 6);
+			coll = __coll_map(buf, &coll_size);
 		}
+		if (map || coll) break;
+	}
+
+	if ((map || coll) && !(new = malloc(sizeof *new))) {
+		if (map) __munmap((void *)map, map_size);
+		if (coll) __munmap((void *)coll, coll_size);
+		map = coll = 0;
 	}
 
 	/* If no locale definition was found, make a locale map
 	 * object anyway to store the name, which is kept for the
 	 * sake of being able to do message translations at the
 	 * application level. */
-	if (!new && (new = malloc(sizeof *new))) {
-		new->map = __c_dot_utf8.map;
-		new->map_size = __c_dot_utf8.map_size;
+	if (new || (new = malloc(sizeof *new))) {
+		if (!map) {
+			map = __c_dot_utf8.map;
+			map_size = __c_dot_utf8.map_size;
+		}
+		new->map = map;
+		new->map_size = map_size;
+		new->coll = coll;
 		memcpy(new->name, val, n);
 		new->name[n] = 0;
 		new->next = loc_head;
@@ -0,0 +1,16 @@
+0,12,12,12,60,126,126,126,126,126,126,126,126,126,126,126,126,126,126,126,126,
+126,126,126,126,126,126,126,126,126,126,126,126,141,149,181,182,182,226,233,
+233,233,233,233,233,233,233,233,233,432,432,432,432,432,432,432,432,432,432,
+432,432,432,432,432,432,432,432,432,432,432,432,432,432,432,432,432,432,432,
+432,547,638,716,832,936,1048,1139,1204,1267,1333,1416,1505,1550,1654,1742,1808,
+1910,2019,2120,2216,2327,2408,2474,2568,2659,2772,2861,2956,3024,3109,3192,
+3270,3353,3426,3476,3535,3609,3665,3720,3829,3913,3977,4033,4106,4201,4285,
+4371,4476,4539,4607,4696,4781,4873,4947,5018,5093,5156,5219,5302,5372,5477,
+5533,5615,5665,5732,5811,5915,5987,6038,6093,6126,6167,6263,6343,6408,6471,
+6525,6591,6635,6699,6755,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,
+6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,
+6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,
+6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,
+6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,
+6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,
+6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6788,6879,
@@ -4,6 +4,8 @@
 
 int __strcoll_l(const char *l, const char *r, locale_t loc)
 {
+	const struct __locale_map *lm = loc->cat[LC_COLLATE];
+	if (lm && lm->coll) return __collate(l, r, 0, lm->coll);
 	return strcmp(l, r);
 }
 
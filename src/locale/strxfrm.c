@@ -2,9 +2,11 @@
 #include <locale.h>
 #include "locale_impl.h"
 
-/* collate only by code points */
+/* collate only by code points, unless the locale has a table */
 size_t __strxfrm_l(char *restrict dest, const char *restrict src, size_t n, locale_t loc)
 {
+	const struct __locale_map *lm = loc->cat[LC_COLLATE];
+	if (lm && lm->coll) return __collate_key(dest, src, n, 0, lm->coll);
 	size_t l = strlen(src);
 	if (n > l) strcpy(dest, src);
 	return l;
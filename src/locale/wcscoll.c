@@ -2,9 +2,10 @@
 #include <locale.h>
 #include "locale_impl.h"
 
-/* FIXME: stub */
 int __wcscoll_l(const wchar_t *l, const wchar_t *r, locale_t locale)
 {
+	const struct __locale_map *lm = locale->cat[LC_COLLATE];
+	if (lm && lm->coll) return __collate(l, r, 1, lm->coll);
 	return wcscmp(l, r);
 }
 
@@ -0,0 +1,30 @@
+#if defined(__clang__) || __GNUC__ >= 9
+#define VLEN 2
+#define MVEC_ABI __attribute__((__aarch64_vector_pcs__))
+#define MVEC_D(f) _ZGVnN2v_##f
+#define MVEC_DD(f) _ZGVnN2vv_##f
+#define MVEC_F(f) _ZGVnN4v_##f
+#define MVEC_FF(f) _ZGVnN4vv_##f
+#include "../mvec.h"
+
+/* 64-bit vector variants of the float functions */
+
+MVEC_ABI vhf _ZGVnN2v_expf(vhf x)
+{
+	vf y = _ZGVnN4v_expf((vf){x[0], x[1], x[0], x[1]});
+	return (vhf){y[0], y[1]};
+}
+
+MVEC_ABI vhf _ZGVnN2v_logf(vhf x)
+{
+	vf y = _ZGVnN4v_logf((vf){x[0], x[1], x[0], x[1]});
+	return (vhf){y[0], y[1]};
+}
+
+MVEC_ABI vhf _ZGVnN2vv_powf(vhf x, vhf y)
+{
+	vf r = _ZGVnN4vv_powf((vf){x[0], x[1], x[0], x[1]},
+		(vf){y[0], y[1], y[0], y[1]});
+	return (vhf){r[0], r[1]};
+}
+#endif
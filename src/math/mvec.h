@@ -0,0 +1,669 @@
+/*
+ * Vector variants of exp, log, pow, sin, cos, expf, logf and powf for
+ * the vector function ABI used by compilers for simd declarations.
+ *
+ * This file is included by the arch specific mvec sources, which select
+ * the instruction set and define
+ *   VLEN           number of double lanes, float variants have 2*VLEN
+ *   MVEC_ABI       calling convention attribute of the exported symbols
+ *   MVEC_D/DD/F/FF mangled names of the unary and binary variants
+ *
+ * The algorithms and tables are those of the scalar functions, lanes
+ * that leave the common path (special values, overflow, underflow,
+ * extreme argument reduction) are recomputed with the scalar function,
+ * so the error bounds are the documented scalar ones.  Floating-point
+ * exception flags may differ from the scalar functions.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include "libm.h"
+#include "exp_data.h"
+#include "log_data.h"
+#include "pow_data.h"
+#include "exp2f_data.h"
+#include "logf_data.h"
+#include "powf_data.h"
+
+#define FLEN (2*VLEN)
+
+typedef double vd __attribute__((__vector_size__(VLEN*8)));
+typedef int64_t vi __attribute__((__vector_size__(VLEN*8)));
+typedef uint64_t vu __attribute__((__vector_size__(VLEN*8)));
+
+typedef float vf __attribute__((__vector_size__(FLEN*4)));
+typedef int32_t vfi __attribute__((__vector_size__(FLEN*4)));
+typedef uint32_t vfu __attribute__((__vector_size__(FLEN*4)));
+
+/* float arguments are evaluated in double precision like in the scalar
+   code, one half of the float lanes at a time */
+typedef float vhf __attribute__((__vector_size__(VLEN*4)));
+typedef int32_t vhi __attribute__((__vector_size__(VLEN*4)));
+union vf2 { vf f; vfi i; vhf hf[2]; vhi hi[2]; };
+
+/* lane by lane conversion, __builtin_convertvector needs GCC 9 */
+#if defined(__clang__) || __GNUC__ >= 9
+#define CONVERT(v, t) __builtin_convertvector(v, t)
+#else
+#define CONVERT(v, t) __extension__ ({ \
+	__typeof__(v) v_ = (v); t r_; \
+	for (int i_ = 0; i_ < sizeof r_ / sizeof r_[0]; i_++) r_[i_] = v_[i_]; \
+	r_; })
+#endif
+
+/* table lookups, built from scalar loads without a round trip through
+   memory: LANES(f) is {f(0), f(1), ...} */
+#if VLEN == 2
+#define LANES(f) {f(0), f(1)}
+#elif VLEN == 4
+#define LANES(f) {f(0), f(1), f(2), f(3)}
+#elif VLEN == 8
+#define LANES(f) {f(0), f(1), f(2), f(3), f(4), f(5), f(6), f(7)}
+#endif
+
+static inline int any(vi m)
+{
+	uint64_t r = 0;
+	for (int i = 0; i < VLEN; i++)
+		r |= m[i];
+	return r != 0;
+}
+
+static inline int anyf(vfi m)
+{
+	uint32_t r = 0;
+	for (int i = 0; i < FLEN; i++)
+		r |= m[i];
+	return r != 0;
+}
+
+/* m ? a : b, lanes of m are all ones or all zeros */
+static inline vd sel(vi m, vd a, vd b)
+{
+	return (vd)(((vu)a & (vu)m) | ((vu)b & ~(vu)m));
+}
+
+static inline vd fixup(vd x, vd y, vi m, double (*f)(double))
+{
+	for (int i = 0; i < VLEN; i++)
+		if (m[i]) y[i] = f(x[i]);
+	return y;
+}
+
+static inline vd fixup2(vd x, vd x2, vd y, vi m, double (*f)(double, double))
+{
+	for (int i = 0; i < VLEN; i++)
+		if (m[i]) y[i] = f(x[i], x2[i]);
+	return y;
+}
+
+static inline vf fixupf(vf x, vf y, vfi m, float (*f)(float))
+{
+	for (int i = 0; i < FLEN; i++)
+		if (m[i]) y[i] = f(x[i]);
+	return y;
+}
+
+static inline vf fixup2f(vf x, vf x2, vf y, vfi m, float (*f)(float, float))
+{
+	for (int i = 0; i < FLEN; i++)
+		if (m[i]) y[i] = f(x[i], x2[i]);
+	return y;
+}
+
+/* small integer to double, |k| < 2^51 */
+static inline vd itod(vi k)
+{
+	return (vd)((vu)k + asuint64(0x1.8p52)) - 0x1.8p52;
+}
+
+static inline vf join(vd lo, vd hi)
+{
+	union vf2 u;
+	u.hf[0] = CONVERT(lo, vhf);
+	u.hf[1] = CONVERT(hi, vhf);
+	return u.f;
+}
+
+/* exp, see exp.c */
+
+#define N (1 << EXP_TABLE_BITS)
+#define InvLn2N __exp_data.invln2N
+#define NegLn2hiN __exp_data.negln2hiN
+#define NegLn2loN __exp_data.negln2loN
+#define Shift __exp_data.shift
+#define T __exp_data.tab
+#define C2 __exp_data.poly[5 - EXP_POLY_ORDER]
+#define C3 __exp_data.poly[6 - EXP_POLY_ORDER]
+#define C4 __exp_data.poly[7 - EXP_POLY_ORDER]
+#define C5 __exp_data.poly[8 - EXP_POLY_ORDER]
+
+/* Computes exp(x+xtail), the caller handles lanes with
+   |x| >= 512 or |x| < 0x1p-54 when xtail is non-zero.  */
+static inline vd exp_inline(vd x, vd xtail)
+{
+	vd kd, z, r, r2, scale, tail, tmp;
+	vu ki, idx, sbits;
+
+	z = InvLn2N * x;
+	kd = z + Shift;
+	ki = (vu)kd;
+	kd -= Shift;
+	r = x + kd * NegLn2hiN + kd * NegLn2loN;
+	r += xtail;
+	idx = 2 * (ki % N);
+#define TAIL(i) asdouble(T[idx[i]])
+#define SBITS(i) T[idx[i] + 1]
+	tail = (vd)LANES(TAIL);
+	sbits = (vu)LANES(SBITS) + (ki << (52 - EXP_TABLE_BITS));
+#undef TAIL
+#undef SBITS
+	r2 = r * r;
+	tmp = tail + r + r2 * (C2 + r * C3) + r2 * r2 * (C4 + r * C5);
+	scale = (vd)sbits;
+	return scale + scale * tmp;
+}
+
+MVEC_ABI vd MVEC_D(exp)(vd x)
+{
+	/* tiny x is fine here, the result is 1+x as in the scalar code */
+	vi special = (vi)(((vu)x >> 52 & 0x7ff) >= 0x408);
+	vd y = exp_inline(x, (vd){0});
+	if (any(special))
+		y = fixup(x, y, special, exp);
+	return y;
+}
+
+#undef N
+#undef T
+#undef C2
+#undef C3
+#undef C4
+#undef C5
+
+/* log, see log.c */
+
+#define T __log_data.tab
+#define T2 __log_data.tab2
+#define B __log_data.poly1
+#define A __log_data.poly
+#define Ln2hi __log_data.ln2hi
+#define Ln2lo __log_data.ln2lo
+#define N (1 << LOG_TABLE_BITS)
+#define OFF 0x3fe6000000000000
+#define LO asuint64(1.0 - 0x1p-4)
+#define HI asuint64(1.0 + 0x1.09p-4)
+
+#define INVC(j) T[i[j]].invc
+#define LOGC(j) T[i[j]].logc
+#define R(j) __builtin_fma(z[j], invc[j], -1.0)
+
+MVEC_ABI vd MVEC_D(log)(vd x)
+{
+	vd w, z, r, r2, r3, y, y1, invc, logc, kd, hi, lo, rhi, rlo;
+	vu ix, iz, tmp, i;
+	vi near1, special;
+
+	ix = (vu)x;
+	near1 = (vi)(ix - LO < HI - LO);
+	/* x < 0x1p-1022 or inf or nan */
+	special = (vi)((ix >> 48) - 0x0010 >= 0x7ff0 - 0x0010);
+
+	tmp = ix - OFF;
+	i = (tmp >> (52 - LOG_TABLE_BITS)) % N;
+	iz = ix - (tmp & 0xfffULL << 52);
+	z = (vd)iz;
+	kd = itod((vi)tmp >> 52);
+	invc = (vd)LANES(INVC);
+	logc = (vd)LANES(LOGC);
+#if __FP_FAST_FMA
+	r = (vd)LANES(R);
+#else
+#define CHI(j) T2[i[j]].chi
+#define CLO(j) T2[i[j]].clo
+	r = (z - (vd)LANES(CHI) - (vd)LANES(CLO)) * invc;
+#undef CHI
+#undef CLO
+#endif
+	w = kd * Ln2hi + logc;
+	hi = w + r;
+	lo = w - hi + r + kd * Ln2lo;
+	r2 = r * r;
+	y = lo + r2 * A[0] +
+	    r * r2 * (A[1] + r * A[2] + r2 * (A[3] + r * A[4])) + hi;
+
+	if (any(near1)) {
+		r = x - 1.0;
+		r2 = r * r;
+		r3 = r * r2;
+		y1 = r3 *
+		     (B[1] + r * B[2] + r2 * B[3] +
+		      r3 * (B[4] + r * B[5] + r2 * B[6] +
+			    r3 * (B[7] + r * B[8] + r2 * B[9] + r3 * B[10])));
+		w = r * 0x1p27;
+		rhi = r + w - w;
+		rlo = r - rhi;
+		w = rhi * rhi * B[0];
+		hi = r + w;
+		lo = r - hi + w;
+		lo += B[0] * rlo * (rhi + r);
+		y1 += lo;
+		y1 += hi;
+		/* log(1) is +0 in all rounding modes */
+		y1 = sel((vi)(ix == asuint64(1.0)), (vd){0}, y1);
+		y = sel(near1, y1, y);
+	}
+	if (any(special))
+		y = fixup(x, y, special, log);
+	return y;
+}
+
+#undef T
+#undef T2
+#undef B
+#undef A
+#undef N
+#undef OFF
+#undef LO
+#undef HI
+#undef Ln2hi
+#undef Ln2lo
+
+/* pow, see pow.c */
+
+#define T __pow_log_data.tab
+#define A __pow_log_data.poly
+#define Ln2hi __pow_log_data.ln2hi
+#define Ln2lo __pow_log_data.ln2lo
+#define N (1 << POW_LOG_TABLE_BITS)
+#define OFF 0x3fe6955500000000
+
+/* log(x) = y + *tail for positive normal x, with about 15 extra bits */
+static inline vd pow_log_inline(vu ix, vd *tail)
+{
+	vd z, r, y, invc, logc, logctail, kd, hi, t1, t2, lo, lo1, lo2, p;
+	vd ar, ar2, ar3, lo3, lo4;
+	vu iz, tmp, i;
+
+	tmp = ix - OFF;
+	i = (tmp >> (52 - POW_LOG_TABLE_BITS)) % N;
+	iz = ix - (tmp & 0xfffULL << 52);
+	z = (vd)iz;
+	kd = itod((vi)tmp >> 52);
+#define LOGCTAIL(j) T[i[j]].logctail
+	invc = (vd)LANES(INVC);
+	logc = (vd)LANES(LOGC);
+	logctail = (vd)LANES(LOGCTAIL);
+#undef LOGCTAIL
+
+#if __FP_FAST_FMA
+	r = (vd)LANES(R);
+#else
+	vd zhi = (vd)((iz + (1ULL << 31)) & (-1ULL << 32));
+	vd zlo = z - zhi;
+	vd rhi = zhi * invc - 1.0;
+	vd rlo = zlo * invc;
+	r = rhi + rlo;
+#endif
+
+	t1 = kd * Ln2hi + logc;
+	t2 = t1 + r;
+	lo1 = kd * Ln2lo + logctail;
+	lo2 = t1 - t2 + r;
+
+	ar = A[0] * r;
+	ar2 = r * ar;
+	ar3 = r * ar2;
+#if __FP_FAST_FMA
+#define LO3(j) __builtin_fma(ar[j], r[j], -ar2[j])
+	hi = t2 + ar2;
+	lo3 = (vd)LANES(LO3);
+	lo4 = t2 - hi + ar2;
+#undef LO3
+#else
+	vd arhi = A[0] * rhi;
+	vd arhi2 = rhi * arhi;
+	hi = t2 + arhi2;
+	lo3 = rlo * (ar + arhi);
+	lo4 = t2 - hi + arhi2;
+#endif
+	p = (ar3 * (A[1] + r * A[2] +
+		    ar2 * (A[3] + r * A[4] + ar2 * (A[5] + r * A[6]))));
+	lo = lo1 + lo2 + lo3 + lo4 + p;
+	y = hi + lo;
+	*tail = hi - y + lo;
+	return y;
+}
+
+#undef INVC
+#undef LOGC
+#undef R
+
+MVEC_ABI vd MVEC_DD(pow)(vd x, vd y)
+{
+	vu ix = (vu)x, iy = (vu)y;
+	vd hi, lo, ehi, elo, r;
+	vi special;
+
+	/* x <= 0, x subnormal, inf or nan, |y| < 0x1p-65, |y| >= 0x1p63
+	   or nan are left to the scalar code, so are negative x.  */
+	special = (vi)((ix >> 52) - 0x001 >= 0x7ff - 0x001) |
+		  (vi)((iy >> 52 & 0x7ff) - 0x3be >= 0x43e - 0x3be);
+
+	hi = pow_log_inline(ix, &lo);
+#if __FP_FAST_FMA
+#define ELO(j) __builtin_fma(y[j], hi[j], -ehi[j])
+	ehi = y * hi;
+	elo = y * lo + (vd)LANES(ELO);
+#undef ELO
+#else
+	vd yhi = (vd)(iy & -1ULL << 27);
+	vd ylo = y - yhi;
+	vd lhi = (vd)((vu)hi & -1ULL << 27);
+	vd llo = hi - lhi + lo;
+	ehi = yhi * lhi;
+	elo = ylo * lhi + y * llo;
+#endif
+	/* overflow, underflow and results close to 1 */
+	special |= (vi)(((vu)ehi >> 52 & 0x7ff) - 0x3c9 >= 0x408 - 0x3c9);
+	r = exp_inline(ehi, elo);
+	if (any(special))
+		r = fixup2(x, y, r, special, pow);
+	return r;
+}
+
+#undef T
+#undef A
+#undef N
+#undef OFF
+#undef Ln2hi
+#undef Ln2lo
+
+/* sin and cos, see __rem_pio2.c, __sin.c and __cos.c */
+
+static const double
+toint   = 0x1.8p52,
+pio4    = 0x1.921fb54442d18p-1,
+invpio2 = 6.36619772367581382433e-01, /* 0x3FE45F30, 0x6DC9C883 */
+pio2_1  = 1.57079632673412561417e+00, /* 0x3FF921FB, 0x54400000 */
+pio2_1t = 6.07710050650619224932e-11, /* 0x3DD0B461, 0x1A626331 */
+pio2_2  = 6.07710050630396597660e-11, /* 0x3DD0B461, 0x1A600000 */
+pio2_2t = 2.02226624879595063154e-21, /* 0x3BA3198A, 0x2E037073 */
+S1  = -1.66666666666666324348e-01, /* 0xBFC55555, 0x55555549 */
+S2  =  8.33333333332248946124e-03, /* 0x3F811111, 0x1110F8A6 */
+S3  = -1.98412698298579493134e-04, /* 0xBF2A01A0, 0x19C161D5 */
+S4  =  2.75573137070700676789e-06, /* 0x3EC71DE3, 0x57B1FE7D */
+S5  = -2.50507602534068634195e-08, /* 0xBE5AE5E6, 0x8A2B9CEB */
+S6  =  1.58969099521155010221e-10, /* 0x3DE5D93A, 0x5ACFD57C */
+C1  =  4.16666666666666019037e-02, /* 0x3FA55555, 0x5555554C */
+C2  = -1.38888888888741095749e-03, /* 0xBF56C16C, 0x16C15177 */
+C3  =  2.48015872894767294178e-05, /* 0x3EFA01A0, 0x19CB1590 */
+C4  = -2.75573143513906633035e-07, /* 0xBE927E4F, 0x809C52AD */
+C5  =  2.08757232129817482790e-09, /* 0x3E21EE9E, 0xBDB4B1C4 */
+C6  = -1.13596475577881948265e-11; /* 0xBDA8FAE9, 0xBE8838D4 */
+
+/* Reduces x to y0+y1 in [-pi/4,pi/4] and returns sin (q=0) or cos (q=1)
+   of x, lanes with |x| >= 2^20*(pi/2) or that need the third round of
+   __rem_pio2 are set in *special.  */
+static inline vd sincos_inline(vd x, uint64_t q, vi *special)
+{
+	vd fn, r, w, t, y0, y1, z, v, s, c;
+	vu ix, n;
+	vi m;
+
+	ix = (vu)x >> 32 & 0x7fffffff;
+	*special = (vi)(ix >= 0x413921fb);
+
+	fn = x * invpio2 + toint;
+	n = (vu)fn;
+	fn -= toint;
+	r = x - fn * pio2_1;
+	w = fn * pio2_1t;
+	/* Matters with directed rounding. */
+	m = (vi)(r - w < -pio4) - (vi)(r - w > pio4);
+	if (any(m)) {
+		n += (vu)m;
+		fn += itod(m);
+		r = x - fn * pio2_1;
+		w = fn * pio2_1t;
+	}
+	y0 = r - w;
+	m = (vi)(ix >> 20) - (vi)((vu)y0 >> 52 & 0x7ff);
+	if (any(m > 16)) {
+		vi m2 = m > 16;
+		vd r2, w2;
+		t = r;
+		w2 = fn * pio2_2;
+		r2 = t - w2;
+		w2 = fn * pio2_2t - ((t - r2) - w2);
+		r = sel(m2, r2, r);
+		w = sel(m2, w2, w);
+		y0 = r - w;
+		m = (vi)(ix >> 20) - (vi)((vu)y0 >> 52 & 0x7ff);
+		*special |= m2 & (m > 49);
+	}
+	y1 = (r - y0) - w;
+
+	/* __sin(y0, y1, 1) */
+	z = y0 * y0;
+	w = z * z;
+	r = S2 + z * (S3 + z * S4) + z * w * (S5 + z * S6);
+	v = z * y0;
+	s = y0 - ((z * (0.5 * y1 - v * r) - y1) - v * S1);
+
+	/* __cos(y0, y1) */
+	r = z * (C1 + z * (C2 + z * C3)) + w * w * (C4 + z * (C5 + z * C6));
+	v = 0.5 * z;
+	w = 1.0 - v;
+	c = w + (((1.0 - w) - v) + (z * r - y0 * y1));
+
+	n += q;
+	s = sel(-(vi)(n & 1), c, s);
+	return (vd)((vu)s ^ (n & 2) << 62);
+}
+
+MVEC_ABI vd MVEC_D(sin)(vd x)
+{
+	vi special;
+	vd y = sincos_inline(x, 0, &special);
+	if (any(special))
+		y = fixup(x, y, special, sin);
+	return y;
+}
+
+MVEC_ABI vd MVEC_D(cos)(vd x)
+{
+	vi special;
+	vd y = sincos_inline(x, 1, &special);
+	if (any(special))
+		y = fixup(x, y, special, cos);
+	return y;
+}
+
+/* expf, see expf.c */
+
+#define N (1 << EXP2F_TABLE_BITS)
+#define T __exp2f_data.tab
+#define C __exp2f_data.poly_scaled
+#define TAB(i) T[ki[i] % N]
+
+static inline vd expf_inline(vd xd)
+{
+	vd kd, z, r, r2, y, s;
+	vu ki;
+
+	z = __exp2f_data.invln2_scaled * xd;
+	kd = z + __exp2f_data.shift;
+	ki = (vu)kd;
+	kd -= __exp2f_data.shift;
+	r = z - kd;
+	s = (vd)((vu)LANES(TAB) + (ki << (52 - EXP2F_TABLE_BITS)));
+	z = C[0] * r + C[1];
+	r2 = r * r;
+	y = C[2] * r + 1;
+	y = z * r2 + y;
+	return y * s;
+}
+
+MVEC_ABI vf MVEC_F(expf)(vf x)
+{
+	union vf2 u = {x};
+	vfi special;
+	vf y;
+
+	special = (vfi)(((vfu)x >> 20 & 0x7ff) >= 0x42b);	/* top12(88.0f) */
+	y = join(expf_inline(CONVERT(u.hf[0], vd)),
+		 expf_inline(CONVERT(u.hf[1], vd)));
+	if (anyf(special))
+		y = fixupf(x, y, special, expf);
+	return y;
+}
+
+#undef C
+
+/* exp2 for powf, see exp2_inline in powf.c */
+
+#define C __exp2f_data.poly
+
+static inline vd exp2f_inline(vd xd)
+{
+	vd kd, z, r, r2, y, s;
+	vu ki;
+
+	kd = xd + __exp2f_data.shift_scaled;
+	ki = (vu)kd;
+	kd -= __exp2f_data.shift_scaled;
+	r = xd - kd;
+	s = (vd)((vu)LANES(TAB) + (ki << (52 - EXP2F_TABLE_BITS)));
+	z = C[0] * r + C[1];
+	r2 = r * r;
+	y = C[2] * r + 1;
+	y = z * r2 + y;
+	return y * s;
+}
+
+#undef N
+#undef T
+#undef C
+#undef TAB
+
+/* logf, see logf.c */
+
+#define T __logf_data.tab
+#define A __logf_data.poly
+#define N (1 << LOGF_TABLE_BITS)
+#define OFF 0x3f330000
+#define INVC(j) T[(tmp[h*VLEN+j] >> (23 - LOGF_TABLE_BITS)) % N].invc
+#define LOGC(j) T[(tmp[h*VLEN+j] >> (23 - LOGF_TABLE_BITS)) % N].logc
+
+/* one half of the lanes, h selects the half of tmp, z and k */
+static inline vd logf_inline(vfu tmp, union vf2 *z, union vf2 *k, int h)
+{
+	vd r, r2, y, y0;
+
+	r = CONVERT(z->hf[h], vd) * (vd)LANES(INVC) - 1;
+	y0 = (vd)LANES(LOGC) +
+	     CONVERT(k->hi[h], vd) * __logf_data.ln2;
+	r2 = r * r;
+	y = A[1] * r + A[2];
+	y = A[0] * r2 + y;
+	return y * r2 + (y0 + r);
+}
+
+MVEC_ABI vf MVEC_F(logf)(vf x)
+{
+	union vf2 z, k;
+	vfu ix, tmp;
+	vfi special, one;
+	vf y;
+
+	ix = (vfu)x;
+	/* x < 0x1p-126 or inf or nan */
+	special = (vfi)(ix - 0x00800000 >= 0x7f800000 - 0x00800000);
+	one = (vfi)(ix == 0x3f800000);
+
+	tmp = ix - OFF;
+	k.i = (vfi)tmp >> 23;
+	z.i = (vfi)(ix - (tmp & 0xff800000));
+	y = join(logf_inline(tmp, &z, &k, 0), logf_inline(tmp, &z, &k, 1));
+
+	/* log(1) is +0 in all rounding modes */
+	y = (vf)((vfu)y & ~(vfu)one);
+	if (anyf(special))
+		y = fixupf(x, y, special, logf);
+	return y;
+}
+
+#undef T
+#undef A
+#undef N
+#undef OFF
+#undef INVC
+#undef LOGC
+
+/* powf, see powf.c */
+
+#define T __powf_log2_data.tab
+#define A __powf_log2_data.poly
+#define N (1 << POWF_LOG2_TABLE_BITS)
+#define OFF 0x3f330000
+#define INVC(j) T[(tmp[h*VLEN+j] >> (23 - POWF_LOG2_TABLE_BITS)) % N].invc
+#define LOGC(j) T[(tmp[h*VLEN+j] >> (23 - POWF_LOG2_TABLE_BITS)) % N].logc
+
+/* y*log2(x) for one half of the lanes, see log2_inline in powf.c */
+static inline vd powf_ylog2(vfu tmp, union vf2 *z, union vf2 *k,
+	union vf2 *y, int h)
+{
+	vd r, r2, r4, p, q, l, l0;
+
+	r = CONVERT(z->hf[h], vd) * (vd)LANES(INVC) - 1;
+	l0 = (vd)LANES(LOGC) + CONVERT(k->hi[h], vd);
+	r2 = r * r;
+	l = A[0] * r + A[1];
+	p = A[2] * r + A[3];
+	r4 = r2 * r2;
+	q = A[4] * r + l0;
+	q = p * r2 + q;
+	l = l * r4 + q;
+	return CONVERT(y->hf[h], vd) * l;
+}
+
+MVEC_ABI vf MVEC_FF(powf)(vf x, vf y)
+{
+	union vf2 z, k, u = {y};
+	vfu ix, iy, tmp, top;
+	vfi special;
+	vd l[2];
+	vi big;
+	vf r;
+
+	ix = (vfu)x;
+	iy = (vfu)y;
+	/* x <= 0, x subnormal, inf or nan, or y zero, inf or nan */
+	special = (vfi)(ix - 0x00800000 >= 0x7f800000 - 0x00800000) |
+		  (vfi)(2 * iy - 1 >= 2u * 0x7f800000 - 1);
+
+	tmp = ix - OFF;
+	top = tmp & 0xff800000;
+	k.i = (vfi)top >> (23 - POWF_SCALE_BITS);
+	z.i = (vfi)(ix - top);
+	for (int h = 0; h < 2; h++) {
+		l[h] = powf_ylog2(tmp, &z, &k, &u, h);
+		/* |y*log(x)| >= 126 */
+		big = (vi)(((vu)l[h] >> 47 & 0xffff) >=
+			   asuint64(126.0 * POWF_SCALE) >> 47);
+		for (int j = 0; j < VLEN; j++)
+			special[h*VLEN+j] |= big[j];
+	}
+	r = join(exp2f_inline(l[0]), exp2f_inline(l[1]));
+	if (anyf(special))
+		r = fixup2f(x, y, r, special, powf);
+	return r;
+}
+
+#undef T
+#undef A
+#undef N
+#undef OFF
+#undef INVC
+#undef LOGC
@@ -18,6 +18,20 @@ double fma(double x, double y, double z)
 
 #else
 
+#include "cpu.h"
+
+#define fma __fma_soft
+hidden double __fma_soft(double, double, double);
 #include "../fma.c"
+#undef fma
+
+double fma(double x, double y, double z)
+{
+	if (__cpu_features & CPU_FMA) {
+		__asm__ ("vfmadd132sd %1, %2, %0" : "+x" (x) : "x" (y), "x" (z));
+		return x;
+	}
+	return __fma_soft(x, y, z);
+}
 
 #endif
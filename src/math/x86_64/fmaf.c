@@ -18,6 +18,20 @@ float fmaf(float x, float y, float z)
 
 #else
 
+#include "cpu.h"
+
+#define fmaf __fmaf_soft
+hidden float __fmaf_soft(float, float, float);
 #include "../fmaf.c"
+#undef fmaf
+
+float fmaf(float x, float y, float z)
+{
+	if (__cpu_features & CPU_FMA) {
+		__asm__ ("vfmadd132ss %1, %2, %0" : "+x" (x) : "x" (y), "x" (z));
+		return x;
+	}
+	return __fmaf_soft(x, y, z);
+}
 
 #endif
@@ -0,0 +1,8 @@
+#pragma GCC target("avx")
+#define VLEN 4
+#define MVEC_ABI
+#define MVEC_D(f) _ZGVcN4v_##f
+#define MVEC_DD(f) _ZGVcN4vv_##f
+#define MVEC_F(f) _ZGVcN8v_##f
+#define MVEC_FF(f) _ZGVcN8vv_##f
+#include "../mvec.h"
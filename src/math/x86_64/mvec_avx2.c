@@ -0,0 +1,8 @@
+#pragma GCC target("avx2")
+#define VLEN 4
+#define MVEC_ABI
+#define MVEC_D(f) _ZGVdN4v_##f
+#define MVEC_DD(f) _ZGVdN4vv_##f
+#define MVEC_F(f) _ZGVdN8v_##f
+#define MVEC_FF(f) _ZGVdN8vv_##f
+#include "../mvec.h"
@@ -0,0 +1,8 @@
+#pragma GCC target("avx512f")
+#define VLEN 8
+#define MVEC_ABI
+#define MVEC_D(f) _ZGVeN8v_##f
+#define MVEC_DD(f) _ZGVeN8vv_##f
+#define MVEC_F(f) _ZGVeN16v_##f
+#define MVEC_FF(f) _ZGVeN16vv_##f
+#include "../mvec.h"
@@ -0,0 +1,7 @@
+#define VLEN 2
+#define MVEC_ABI
+#define MVEC_D(f) _ZGVbN2v_##f
+#define MVEC_DD(f) _ZGVbN2vv_##f
+#define MVEC_F(f) _ZGVbN4v_##f
+#define MVEC_FF(f) _ZGVbN4vv_##f
+#include "../mvec.h"
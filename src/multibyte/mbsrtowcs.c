@@ -3,8 +3,40 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <endian.h>
 #include "internal.h"
 
+#if defined(__GNUC__) && (__GNUC__ >= 12 || defined(__clang__)) \
+ && __BYTE_ORDER == __LITTLE_ENDIAN
+#define ASCII16
+typedef unsigned char v16u8 __attribute__((__vector_size__(16), __may_alias__));
+typedef uint16_t v8u16 __attribute__((__vector_size__(16)));
+typedef uint32_t v4u32 __attribute__((__vector_size__(16), __may_alias__, __aligned__(4)));
+typedef uint64_t v2u64 __attribute__((__vector_size__(16)));
+
+/* Whether all 16 bytes at s, which must be aligned, are in [1,0x7f]. */
+static int ascii16(const unsigned char *s)
+{
+	v2u64 m = (v2u64)(*(v16u8 *)s - 1 >= 0x7f);
+	return !(m[0] | m[1]);
+}
+
+/* Zero-extend 16 bytes to wchar_t by interleaving with zeros. */
+static void widen16(wchar_t *ws, const unsigned char *s)
+{
+	v16u8 v = *(v16u8 *)s, z = { 0 };
+	v8u16 lo = (v8u16)__builtin_shufflevector(v, z,
+		0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+	v8u16 hi = (v8u16)__builtin_shufflevector(v, z,
+		8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+	v8u16 zz = { 0 };
+	*(v4u32 *)ws = (v4u32)__builtin_shufflevector(lo, zz, 0, 8, 1, 9, 2, 10, 3, 11);
+	*(v4u32 *)(ws+4) = (v4u32)__builtin_shufflevector(lo, zz, 4, 12, 5, 13, 6, 14, 7, 15);
+	*(v4u32 *)(ws+8) = (v4u32)__builtin_shufflevector(hi, zz, 0, 8, 1, 9, 2, 10, 3, 11);
+	*(v4u32 *)(ws+12) = (v4u32)__builtin_shufflevector(hi, zz, 4, 12, 5, 13, 6, 14, 7, 15);
+}
+#endif
+
 size_t mbsrtowcs(wchar_t *restrict ws, const char **restrict src, size_t wn, mbstate_t *restrict st)
 {
 	const unsigned char *s = (const void *)*src;
@@ -41,6 +73,16 @@ size_t mbsrtowcs(wchar_t *restrict ws, const char **restrict src, size_t wn, mbs
 #ifdef __GNUC__
 		typedef uint32_t __attribute__((__may_alias__)) w32;
 		if (*s-1u < 0x7f && (uintptr_t)s%4 == 0) {
+#ifdef ASCII16
+			while ((uintptr_t)s%16 && !(( *(w32*)s | *(w32*)s-0x01010101) & 0x80808080)) {
+				s += 4;
+				wn -= 4;
+			}
+			while ((uintptr_t)s%16 == 0 && ascii16(s)) {
+				s += 16;
+				wn -= 16;
+			}
+#endif
 			while (!(( *(w32*)s | *(w32*)s-0x01010101) & 0x80808080)) {
 				s += 4;
 				wn -= 4;
@@ -75,6 +117,21 @@ resume0:
 #ifdef __GNUC__
 		typedef uint32_t __attribute__((__may_alias__)) w32;
 		if (*s-1u < 0x7f && (uintptr_t)s%4 == 0) {
+#ifdef ASCII16
+			while (wn>=5 && (uintptr_t)s%16 && !(( *(w32*)s | *(w32*)s-0x01010101) & 0x80808080)) {
+				*ws++ = *s++;
+				*ws++ = *s++;
+				*ws++ = *s++;
+				*ws++ = *s++;
+				wn -= 4;
+			}
+			while (wn>=17 && (uintptr_t)s%16 == 0 && ascii16(s)) {
+				widen16(ws, s);
+				s += 16;
+				ws += 16;
+				wn -= 16;
+			}
+#endif
 			while (wn>=5 && !(( *(w32*)s | *(w32*)s-0x01010101) & 0x80808080)) {
 				*ws++ = *s++;
 				*ws++ = *s++;
@@ -1,4 +1,38 @@
 #include <wchar.h>
+#include <stdint.h>
+#include <endian.h>
+
+#if defined(__GNUC__) && (__GNUC__ >= 12 || defined(__clang__)) \
+ && __BYTE_ORDER == __LITTLE_ENDIAN
+#define ASCII16
+typedef uint32_t v4u32 __attribute__((__vector_size__(16), __may_alias__));
+typedef uint16_t v8u16 __attribute__((__vector_size__(16)));
+typedef unsigned char v16u8 __attribute__((__vector_size__(16), __may_alias__, __aligned__(1)));
+typedef uint64_t v2u64 __attribute__((__vector_size__(16)));
+
+/* Whether the 16 wide characters at ws, which must be aligned to 64
+ * bytes so the loads stay within a page, are all in [1,0x7f]. */
+static int ascii16(const wchar_t *ws)
+{
+	v4u32 a = *(v4u32 *)ws, b = *(v4u32 *)(ws+4);
+	v4u32 c = *(v4u32 *)(ws+8), d = *(v4u32 *)(ws+12);
+	v2u64 m = (v2u64)((a|b|c|d) & ~0x7fu | (v4u32)(a==0) | (v4u32)(b==0)
+		| (v4u32)(c==0) | (v4u32)(d==0));
+	return !(m[0] | m[1]);
+}
+
+/* Narrow 16 ASCII wide characters by taking the low half of each
+ * lane, twice. */
+static void narrow16(char *s, const wchar_t *ws)
+{
+	v8u16 a = (v8u16)*(v4u32 *)ws, b = (v8u16)*(v4u32 *)(ws+4);
+	v8u16 c = (v8u16)*(v4u32 *)(ws+8), d = (v8u16)*(v4u32 *)(ws+12);
+	v16u8 ab = (v16u8)__builtin_shufflevector(a, b, 0, 2, 4, 6, 8, 10, 12, 14);
+	v16u8 cd = (v16u8)__builtin_shufflevector(c, d, 0, 2, 4, 6, 8, 10, 12, 14);
+	*(v16u8 *)s = __builtin_shufflevector(ab, cd,
+		0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+}
+#endif
 
 size_t wcsrtombs(char *restrict s, const wchar_t **restrict ws, size_t n, mbstate_t *restrict st)
 {
@@ -7,6 +41,13 @@ size_t wcsrtombs(char *restrict s, const wchar_t **restrict ws, size_t n, mbstat
 	size_t N = n, l;
 	if (!s) {
 		for (n=0, ws2=*ws; *ws2; ws2++) {
+#ifdef ASCII16
+			while ((uintptr_t)ws2%64 == 0 && ascii16(ws2)) {
+				ws2 += 16;
+				n += 16;
+			}
+			if (!*ws2) break;
+#endif
 			if (*ws2 >= 0x80u) {
 				l = wcrtomb(buf, *ws2, 0);
 				if (!(l+1)) return -1;
@@ -16,6 +57,15 @@ size_t wcsrtombs(char *restrict s, const wchar_t **restrict ws, size_t n, mbstat
 		return n;
 	}
 	while (n>=4) {
+#ifdef ASCII16
+		while (n>=16 && (uintptr_t)*ws%64 == 0 && ascii16(*ws)) {
+			narrow16(s, *ws);
+			s += 16;
+			n -= 16;
+			*ws += 16;
+		}
+		if (n<4) break;
+#endif
 		if (**ws-1u >= 0x7fu) {
 			if (!**ws) {
 				*s = 0;
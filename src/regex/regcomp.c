@@ -2465,6 +2465,313 @@ tre_compute_nfl(tre_mem_t mem, tre_stack_t *stack, tre_ast_node_t *tree)
 }
 
 
+/***********************************************************************
+ Required literal extraction
+***********************************************************************/
+
+/*
+  A string of ASCII characters that every match must contain is found
+  by a bottom-up pass over the AST, in the manner of grep's "must"
+  computation.  For each node this tracks a string every match starts
+  with, one every match ends with, one every match contains, and
+  whether the node matches exactly one string.  The strings are kept
+  to at most TRE_MUST_MAX characters, truncating in whichever direction
+  keeps them valid.
+*/
+
+#define TRE_MUST_MAX 32
+
+typedef struct {
+  int exact;
+  int llen, rlen, ilen;
+  char left[TRE_MUST_MAX];
+  char right[TRE_MUST_MAX];
+  char in[TRE_MUST_MAX];
+} tre_must_t;
+
+typedef enum {
+  MUST_RECURSE,
+  MUST_POST_UNION,
+  MUST_POST_CATENATION,
+  MUST_POST_ITERATION
+} tre_must_stack_symbol_t;
+
+static void
+tre_must_literal(tre_must_t *m, const tre_literal_t *lit)
+{
+  memset(m, 0, sizeof(*m));
+  if (IS_EMPTY(lit) || IS_ASSERTION(lit) || IS_TAG(lit))
+    {
+      m->exact = 1;
+    }
+  else if (!IS_BACKREF(lit) && lit->code_min == lit->code_max
+	   && lit->code_min > 0 && lit->code_min < 128
+	   && !lit->class && !lit->neg_classes)
+    {
+      m->exact = 1;
+      m->llen = m->rlen = m->ilen = 1;
+      m->left[0] = m->right[0] = m->in[0] = lit->code_min;
+    }
+}
+
+static void
+tre_must_catenation(tre_must_t *m, const tre_must_t *l, const tre_must_t *r)
+{
+  char buf[2*TRE_MUST_MAX];
+  int n;
+
+  /* Anything spanning the junction is required as a whole. */
+  memcpy(buf, l->right, l->rlen);
+  memcpy(buf + l->rlen, r->left, r->llen);
+  n = l->rlen + r->llen;
+
+  m->exact = l->exact && r->exact && n <= TRE_MUST_MAX;
+
+  if (l->exact)
+    {
+      m->llen = MIN(n, TRE_MUST_MAX);
+      memcpy(m->left, buf, m->llen);
+    }
+  else
+    {
+      m->llen = l->llen;
+      memcpy(m->left, l->left, l->llen);
+    }
+
+  if (r->exact)
+    {
+      m->rlen = MIN(n, TRE_MUST_MAX);
+      memcpy(m->right, buf + n - m->rlen, m->rlen);
+    }
+  else
+    {
+      m->rlen = r->rlen;
+      memcpy(m->right, r->right, r->rlen);
+    }
+
+  m->ilen = MIN(n, TRE_MUST_MAX);
+  memcpy(m->in, buf, m->ilen);
+  if (l->ilen > m->ilen)
+    {
+      m->ilen = l->ilen;
+      memcpy(m->in, l->in, l->ilen);
+    }
+  if (r->ilen > m->ilen)
+    {
+      m->ilen = r->ilen;
+      memcpy(m->in, r->in, r->ilen);
+    }
+}
+
+static void
+tre_must_union(tre_must_t *m, const tre_must_t *l, const tre_must_t *r)
+{
+  int n;
+
+  m->exact = l->exact && r->exact && l->llen == r->llen
+    && !memcmp(l->left, r->left, l->llen);
+
+  for (n = 0; n < l->llen && n < r->llen && l->left[n] == r->left[n]; n++);
+  m->llen = n;
+  memmove(m->left, l->left, n);
+
+  for (n = 0; n < l->rlen && n < r->rlen
+	 && l->right[l->rlen-1-n] == r->right[r->rlen-1-n]; n++);
+  m->rlen = n;
+  memmove(m->right, l->right + l->rlen - n, n);
+
+  if (m->llen >= m->rlen)
+    {
+      m->ilen = m->llen;
+      memcpy(m->in, m->left, m->llen);
+    }
+  else
+    {
+      m->ilen = m->rlen;
+      memcpy(m->in, m->right, m->rlen);
+    }
+}
+
+/* Stores the longest required string found in `tnfa->required_chars',
+   or leaves it NULL if there is none. */
+static reg_errcode_t
+tre_compute_must(tre_mem_t mem, tre_stack_t *stack, tre_ast_node_t *tree,
+		 tre_tnfa_t *tnfa)
+{
+  int bottom = tre_stack_num_objects(stack);
+  tre_stack_t *values;
+  tre_must_t *m, *l, *r;
+  reg_errcode_t status = REG_OK;
+
+  STACK_PUSHR(stack, voidptr, tree);
+  STACK_PUSHR(stack, int, MUST_RECURSE);
+
+  values = tre_stack_new(64, 1024000, 64);
+  if (!values)
+    status = REG_ESPACE;
+
+  while (status == REG_OK && tre_stack_num_objects(stack) > bottom)
+    {
+      tre_must_stack_symbol_t symbol;
+      tre_ast_node_t *node;
+
+      symbol = (tre_must_stack_symbol_t)tre_stack_pop_int(stack);
+      node = tre_stack_pop_voidptr(stack);
+      switch (symbol)
+	{
+	case MUST_RECURSE:
+	  switch (node->type)
+	    {
+	    case LITERAL:
+	      m = tre_mem_alloc(mem, sizeof(*m));
+	      if (!m)
+		{
+		  status = REG_ESPACE;
+		  break;
+		}
+	      tre_must_literal(m, node->obj);
+	      STACK_PUSHX(values, voidptr, m);
+	      break;
+
+	    case UNION:
+	      STACK_PUSHX(stack, voidptr, node);
+	      STACK_PUSHX(stack, int, MUST_POST_UNION);
+	      STACK_PUSHX(stack, voidptr, ((tre_union_t *)node->obj)->right);
+	      STACK_PUSHX(stack, int, MUST_RECURSE);
+	      STACK_PUSHX(stack, voidptr, ((tre_union_t *)node->obj)->left);
+	      STACK_PUSHX(stack, int, MUST_RECURSE);
+	      break;
+
+	    case CATENATION:
+	      STACK_PUSHX(stack, voidptr, node);
+	      STACK_PUSHX(stack, int, MUST_POST_CATENATION);
+	      STACK_PUSHX(stack, voidptr,
+			  ((tre_catenation_t *)node->obj)->right);
+	      STACK_PUSHX(stack, int, MUST_RECURSE);
+	      STACK_PUSHX(stack, voidptr,
+			  ((tre_catenation_t *)node->obj)->left);
+	      STACK_PUSHX(stack, int, MUST_RECURSE);
+	      break;
+
+	    case ITERATION:
+	      STACK_PUSHX(stack, voidptr, node);
+	      STACK_PUSHX(stack, int, MUST_POST_ITERATION);
+	      STACK_PUSHX(stack, voidptr, ((tre_iteration_t *)node->obj)->arg);
+	      STACK_PUSHX(stack, int, MUST_RECURSE);
+	      break;
+	    }
+	  break;
+
+	case MUST_POST_UNION:
+	case MUST_POST_CATENATION:
+	  /* The children's results are reused for the node's. */
+	  r = tre_stack_pop_voidptr(values);
+	  l = tre_stack_pop_voidptr(values);
+	  m = tre_mem_alloc(mem, sizeof(*m));
+	  if (!m)
+	    {
+	      status = REG_ESPACE;
+	      break;
+	    }
+	  if (symbol == MUST_POST_UNION)
+	    tre_must_union(m, l, r);
+	  else
+	    tre_must_catenation(m, l, r);
+	  STACK_PUSHX(values, voidptr, m);
+	  break;
+
+	case MUST_POST_ITERATION:
+	  {
+	    tre_iteration_t *iter = node->obj;
+	    m = tre_stack_pop_voidptr(values);
+	    /* Every match of the node starts and ends with one of the
+	       argument, unless it can be repeated zero times. */
+	    if (iter->min == 0)
+	      memset(m, 0, sizeof(*m));
+	    else if (iter->min != 1 || iter->max != 1)
+	      m->exact = 0;
+	    STACK_PUSHX(values, voidptr, m);
+	    break;
+	  }
+	}
+    }
+
+  if (status == REG_OK)
+    {
+      m = tre_stack_pop_voidptr(values);
+      if (m->ilen > 0)
+	{
+	  tnfa->required_chars = xmalloc(m->ilen + 1);
+	  if (!tnfa->required_chars)
+	    status = REG_ESPACE;
+	  else
+	    {
+	      memcpy(tnfa->required_chars, m->in, m->ilen);
+	      tnfa->required_chars[m->ilen] = 0;
+	    }
+	}
+    }
+  /* On failure, discard whatever is left above the caller's items. */
+  while (tre_stack_num_objects(stack) > bottom)
+    tre_stack_pop_int(stack);
+  if (values)
+    tre_stack_destroy(values);
+  return status;
+}
+
+
+/* Marks the ASCII characters a match can start with in
+   `tnfa->firstpos_chars', with the entries for bytes 128 to 255 set if
+   a match can start with any other character.  If that is exactly one
+   ASCII character, it is also stored in `tnfa->first_char'.  Nothing
+   is stored if a match can be empty or its start depends on context. */
+static reg_errcode_t
+tre_compute_first_chars(tre_tnfa_t *tnfa)
+{
+  tre_tnfa_transition_t *init, *trans;
+  char *set;
+  int c, n;
+
+  tnfa->first_char = -1;
+  for (init = tnfa->initial; init->state; init++)
+    {
+      if (init->assertions || init->state == tnfa->final)
+	return REG_OK;
+      /* The final states of a regex set are its only states without
+	 transitions. */
+      if (tnfa->num_finals && !init->state->state)
+	return REG_OK;
+    }
+
+  set = xcalloc(256, 1);
+  if (!set)
+    return REG_ESPACE;
+  for (init = tnfa->initial; init->state; init++)
+    for (trans = init->state; trans->state; trans++)
+      {
+	for (c = trans->code_min; c <= trans->code_max && c < 128; c++)
+	  set[c] = 1;
+	if (trans->code_max >= 128)
+	  memset(set + 128, 1, 128);
+      }
+
+  for (c = n = 0; c < 128; c++)
+    if (set[c])
+      n++;
+  /* Skipping ahead only pays off when few characters can start. */
+  if (n > 64)
+    {
+      xfree(set);
+      return REG_OK;
+    }
+  if (n == 1)
+    for (c = 0; c < 128; c++)
+      if (set[c])
+	tnfa->first_char = c;
+  tnfa->firstpos_chars = set;
+  return REG_OK;
+}
+
 /* Adds a transition from each position in `p1' to each position in `p2'. */
 static reg_errcode_t
 tre_make_trans(tre_pos_and_tags_t *p1, tre_pos_and_tags_t *p2,
@@ -2687,15 +2994,106 @@ tre_ast_to_tnfa(tre_ast_node_t *node, tre_tnfa_transition_t *transitions,
  while (/*CONSTCOND*/0)
 
 
-int
-regcomp(regex_t *restrict preg, const char *restrict regex, int cflags)
+/* Computes the nullable, firstpos and lastpos sets of `tree', which has
+   `num_states' positions, and builds the transitions and initial states
+   of `tnfa' from them.  The final state is the last position of the
+   tree. */
+static reg_errcode_t
+tre_build_tnfa(tre_mem_t mem, tre_stack_t *stack, tre_ast_node_t *tree,
+	       int num_states, tre_tnfa_t *tnfa)
 {
-  tre_stack_t *stack;
-  tre_ast_node_t *tree, *tmp_ast_l, *tmp_ast_r;
   tre_pos_and_tags_t *p;
   int *counts = NULL, *offs = NULL;
   int i, add = 0;
   tre_tnfa_transition_t *transitions, *initial;
+  reg_errcode_t errcode;
+
+  errcode = tre_compute_nfl(mem, stack, tree);
+  if (errcode != REG_OK)
+    ERROR_EXIT(errcode);
+
+  counts = xmalloc(sizeof(int) * num_states);
+  if (counts == NULL)
+    ERROR_EXIT(REG_ESPACE);
+
+  offs = xmalloc(sizeof(int) * num_states);
+  if (offs == NULL)
+    ERROR_EXIT(REG_ESPACE);
+
+  for (i = 0; i < num_states; i++)
+    counts[i] = 0;
+  tre_ast_to_tnfa(tree, NULL, counts, NULL);
+
+  add = 0;
+  for (i = 0; i < num_states; i++)
+    {
+      offs[i] = add;
+      add += counts[i] + 1;
+      counts[i] = 0;
+    }
+  transitions = xcalloc((unsigned)add + 1, sizeof(*transitions));
+  if (transitions == NULL)
+    ERROR_EXIT(REG_ESPACE);
+  tnfa->transitions = transitions;
+  tnfa->num_transitions = add;
+
+  errcode = tre_ast_to_tnfa(tree, transitions, counts, offs);
+  if (errcode != REG_OK)
+    ERROR_EXIT(errcode);
+
+  tnfa->firstpos_chars = NULL;
+
+  p = tree->firstpos;
+  i = 0;
+  while (p->position >= 0)
+    {
+      i++;
+      p++;
+    }
+
+  initial = xcalloc((unsigned)i + 1, sizeof(tre_tnfa_transition_t));
+  if (initial == NULL)
+    ERROR_EXIT(REG_ESPACE);
+  tnfa->initial = initial;
+
+  i = 0;
+  for (p = tree->firstpos; p->position >= 0; p++)
+    {
+      initial[i].state = transitions + offs[p->position];
+      initial[i].state_id = p->position;
+      initial[i].tags = NULL;
+      /* Copy the arrays p->tags, and p->params, they are allocated
+	 from a tre_mem object. */
+      if (p->tags)
+	{
+	  int j;
+	  for (j = 0; p->tags[j] >= 0; j++);
+	  initial[i].tags = xmalloc(sizeof(*p->tags) * (j + 1));
+	  if (!initial[i].tags)
+	    ERROR_EXIT(REG_ESPACE);
+	  memcpy(initial[i].tags, p->tags, sizeof(*p->tags) * (j + 1));
+	}
+      initial[i].assertions = p->assertions;
+      i++;
+    }
+  initial[i].state = NULL;
+
+  tnfa->num_transitions = add;
+  tnfa->final = transitions + offs[tree->lastpos[0].position];
+  errcode = REG_OK;
+
+ error_exit:
+  xfree(counts);
+  xfree(offs);
+  return errcode;
+}
+
+
+int
+regcomp(regex_t *restrict preg, const char *restrict regex, int cflags)
+{
+  tre_stack_t *stack;
+  tre_ast_node_t *tree, *tmp_ast_l, *tmp_ast_r;
   tre_tnfa_t *tnfa = NULL;
   tre_submatch_data_t *submatch_data;
   tre_tag_direction_t *tag_directions = NULL;
@@ -2747,6 +3145,12 @@ regcomp(regex_t *restrict preg, const char *restrict regex, int cflags)
   tnfa->have_approx = 0;
   tnfa->num_submatches = parse_ctx.submatch_id;
 
+  /* Find a string every match contains, for regexec to look for before
+     running the automaton. */
+  errcode = tre_compute_must(mem, stack, tree, tnfa);
+  if (errcode != REG_OK)
+    ERROR_EXIT(errcode);
+
   /* Set up tags for submatch addressing.  If REG_NOSUB is set and the
      regexp does not have back references, this can be skipped. */
   if (tnfa->have_backrefs || !(cflags & REG_NOSUB))
@@ -2803,85 +3207,19 @@ regcomp(regex_t *restrict preg, const char *restrict regex, int cflags)
   if (tree == NULL)
     ERROR_EXIT(REG_ESPACE);
 
-  errcode = tre_compute_nfl(mem, stack, tree);
+  errcode = tre_build_tnfa(mem, stack, tree, parse_ctx.position, tnfa);
   if (errcode != REG_OK)
     ERROR_EXIT(errcode);
 
-  counts = xmalloc(sizeof(int) * parse_ctx.position);
-  if (counts == NULL)
-    ERROR_EXIT(REG_ESPACE);
-
-  offs = xmalloc(sizeof(int) * parse_ctx.position);
-  if (offs == NULL)
-    ERROR_EXIT(REG_ESPACE);
-
-  for (i = 0; i < parse_ctx.position; i++)
-    counts[i] = 0;
-  tre_ast_to_tnfa(tree, NULL, counts, NULL);
-
-  add = 0;
-  for (i = 0; i < parse_ctx.position; i++)
-    {
-      offs[i] = add;
-      add += counts[i] + 1;
-      counts[i] = 0;
-    }
-  transitions = xcalloc((unsigned)add + 1, sizeof(*transitions));
-  if (transitions == NULL)
-    ERROR_EXIT(REG_ESPACE);
-  tnfa->transitions = transitions;
-  tnfa->num_transitions = add;
+  tnfa->num_states = parse_ctx.position;
+  tnfa->cflags = cflags;
 
-  errcode = tre_ast_to_tnfa(tree, transitions, counts, offs);
+  errcode = tre_compute_first_chars(tnfa);
   if (errcode != REG_OK)
     ERROR_EXIT(errcode);
 
-  tnfa->firstpos_chars = NULL;
-
-  p = tree->firstpos;
-  i = 0;
-  while (p->position >= 0)
-    {
-      i++;
-      p++;
-    }
-
-  initial = xcalloc((unsigned)i + 1, sizeof(tre_tnfa_transition_t));
-  if (initial == NULL)
-    ERROR_EXIT(REG_ESPACE);
-  tnfa->initial = initial;
-
-  i = 0;
-  for (p = tree->firstpos; p->position >= 0; p++)
-    {
-      initial[i].state = transitions + offs[p->position];
-      initial[i].state_id = p->position;
-      initial[i].tags = NULL;
-      /* Copy the arrays p->tags, and p->params, they are allocated
-	 from a tre_mem object. */
-      if (p->tags)
-	{
-	  int j;
-	  for (j = 0; p->tags[j] >= 0; j++);
-	  initial[i].tags = xmalloc(sizeof(*p->tags) * (j + 1));
-	  if (!initial[i].tags)
-	    ERROR_EXIT(REG_ESPACE);
-	  memcpy(initial[i].tags, p->tags, sizeof(*p->tags) * (j + 1));
-	}
-      initial[i].assertions = p->assertions;
-      i++;
-    }
-  initial[i].state = NULL;
-
-  tnfa->num_transitions = add;
-  tnfa->final = transitions + offs[tree->lastpos[0].position];
-  tnfa->num_states = parse_ctx.position;
-  tnfa->cflags = cflags;
-
   tre_mem_destroy(mem);
   tre_stack_destroy(stack);
-  xfree(counts);
-  xfree(offs);
 
   preg->TRE_REGEX_T_FIELD = (void *)tnfa;
   return REG_OK;
@@ -2891,10 +3229,6 @@ regcomp(regex_t *restrict preg, const char *restrict regex, int cflags)
   tre_mem_destroy(mem);
   if (stack != NULL)
     tre_stack_destroy(stack);
-  if (counts != NULL)
-    xfree(counts);
-  if (offs != NULL)
-    xfree(offs);
   preg->TRE_REGEX_T_FIELD = (void *)tnfa;
   regfree(preg);
   return errcode;
@@ -2903,14 +3237,12 @@ regcomp(regex_t *restrict preg, const char *restrict regex, int cflags)
 
 
 
-void
-regfree(regex_t *preg)
+static void
+tre_free(tre_tnfa_t *tnfa)
 {
-  tre_tnfa_t *tnfa;
   unsigned int i;
   tre_tnfa_transition_t *trans;
 
-  tnfa = (void *)preg->TRE_REGEX_T_FIELD;
   if (!tnfa)
     return;
 
@@ -2947,7 +3279,170 @@ regfree(regex_t *preg)
     xfree(tnfa->tag_directions);
   if (tnfa->firstpos_chars)
     xfree(tnfa->firstpos_chars);
+  if (tnfa->required_chars)
+    xfree(tnfa->required_chars);
   if (tnfa->minimal_tags)
     xfree(tnfa->minimal_tags);
+  if (tnfa->final_ids)
+    xfree(tnfa->final_ids);
+  if (tnfa->members)
+    {
+      for (i = 0; i < tnfa->num_finals; i++)
+	tre_free(tnfa->members[i].TRE_REGEX_T_FIELD);
+      xfree(tnfa->members);
+    }
+  if (tnfa->member_keys)
+    xfree(tnfa->member_keys);
+  if (tnfa->member_patterns)
+    xfree(tnfa->member_patterns);
+  if (tnfa->dfa)
+    tre_dfa_free(tnfa->dfa);
   xfree(tnfa);
 }
+
+void
+regfree(regex_t *preg)
+{
+  tre_free((void *)preg->TRE_REGEX_T_FIELD);
+}
+
+
+/*
+  Regex sets: several regexes compiled into one TNFA, whose union is
+  matched in a single pass by regsetexec to find which of them match.
+  Each regex gets its own final state, so the TNFA has one per regex,
+  recorded in `final_ids'.  Back references cannot be matched this way
+  and are rejected, and no submatch information is kept.
+*/
+
+int
+regsetcomp(regset_t *restrict set, const char *const *restrict patterns,
+	   size_t n, int cflags)
+{
+  tre_stack_t *stack;
+  tre_ast_node_t **trees = NULL, *tree, *final;
+  tre_tnfa_t *tnfa = NULL;
+  reg_errcode_t errcode;
+  tre_mem_t mem;
+  size_t i, m;
+
+  /* Parse context. */
+  tre_parse_ctx_t parse_ctx;
+
+  set->re_nset = n;
+  set->__opaque = NULL;
+  if (n == 0 || n > INT_MAX)
+    return REG_BADPAT;
+
+  stack = tre_stack_new(512, 1024000, 128);
+  if (!stack)
+    return REG_ESPACE;
+  mem = tre_mem_new();
+  if (!mem)
+    {
+      tre_stack_destroy(stack);
+      return REG_ESPACE;
+    }
+
+  tnfa = xcalloc(1, sizeof(tre_tnfa_t));
+  if (tnfa == NULL)
+    ERROR_EXIT(REG_ESPACE);
+  tnfa->final_ids = xmalloc(n * sizeof(*tnfa->final_ids));
+  trees = xmalloc(n * sizeof(*trees));
+  if (tnfa->final_ids == NULL || trees == NULL)
+    ERROR_EXIT(REG_ESPACE);
+
+  /* Parse and expand each regex and append its own final node.  The
+     positions keep counting up across the regexes, so that they are
+     all distinct in the combined tree. */
+  memset(&parse_ctx, 0, sizeof(parse_ctx));
+  parse_ctx.mem = mem;
+  parse_ctx.stack = stack;
+  parse_ctx.cflags = cflags;
+  for (i = 0; i < n; i++)
+    {
+      set->re_nset = i;
+      parse_ctx.start = patterns[i];
+      parse_ctx.submatch_id = 0;
+      parse_ctx.max_backref = -1;
+      errcode = tre_parse(&parse_ctx);
+      if (errcode != REG_OK)
+	ERROR_EXIT(errcode);
+      if (parse_ctx.max_backref >= 0)
+	ERROR_EXIT(REG_BADPAT);
+      tree = parse_ctx.n;
+
+      errcode = tre_expand_ast(mem, stack, tree, &parse_ctx.position, NULL);
+      if (errcode != REG_OK)
+	ERROR_EXIT(errcode);
+
+      tnfa->final_ids[i] = parse_ctx.position;
+      final = tre_ast_new_literal(mem, 0, 0, parse_ctx.position++);
+      if (final == NULL)
+	ERROR_EXIT(REG_ESPACE);
+      trees[i] = tre_ast_new_catenation(mem, tree, final);
+      if (trees[i] == NULL)
+	ERROR_EXIT(REG_ESPACE);
+    }
+  set->re_nset = n;
+
+  /* Join the regexes with a balanced tree of unions, so that its depth
+     grows only logarithmically with their number. */
+  for (m = n; m > 1; m = (m + 1) / 2)
+    {
+      for (i = 0; i < m / 2; i++)
+	{
+	  trees[i] = tre_ast_new_union(mem, trees[2 * i], trees[2 * i + 1]);
+	  if (trees[i] == NULL)
+	    ERROR_EXIT(REG_ESPACE);
+	}
+      if (m % 2)
+	trees[m / 2] = trees[m - 1];
+    }
+
+  errcode = tre_build_tnfa(mem, stack, trees[0], parse_ctx.position, tnfa);
+  if (errcode != REG_OK)
+    ERROR_EXIT(errcode);
+
+  tnfa->final = NULL;
+  tnfa->num_finals = n;
+  tnfa->num_states = parse_ctx.position;
+  tnfa->cflags = cflags | REG_NOSUB;
+
+  errcode = tre_compute_first_chars(tnfa);
+  if (errcode != REG_OK)
+    ERROR_EXIT(errcode);
+
+  /* Keep the patterns, for regsetexec to compile them one by one if
+     it finds the set thrashing. */
+  for (i = m = 0; i < n; i++)
+    m += strlen(patterns[i]) + 1;
+  tnfa->member_patterns = xmalloc(m);
+  if (tnfa->member_patterns == NULL)
+    ERROR_EXIT(REG_ESPACE);
+  for (i = m = 0; i < n; i++)
+    {
+      size_t l = strlen(patterns[i]) + 1;
+      memcpy(tnfa->member_patterns + m, patterns[i], l);
+      m += l;
+    }
+
+  tre_mem_destroy(mem);
+  tre_stack_destroy(stack);
+  xfree(trees);
+  set->__opaque = tnfa;
+  return REG_OK;
+
+ error_exit:
+  tre_mem_destroy(mem);
+  tre_stack_destroy(stack);
+  xfree(trees);
+  tre_free(tnfa);
+  return errcode;
+}
+
+void
+regsetfree(regset_t *set)
+{
+  tre_free(set->__opaque);
+}
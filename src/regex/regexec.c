@@ -39,6 +39,8 @@
 #include <regex.h>
 
 #include "tre.h"
+#include "lock.h"
+#include "atomic.h"
 
 #include <assert.h>
 
@@ -920,6 +922,782 @@ tre_tnfa_run_backtrack(const tre_tnfa_t *tnfa, const void *string,
   return ret;
 }
 
+/***********************************************************************
+ Lazy DFA matcher
+***********************************************************************/
+
+/*
+  When only the existence of a match is of interest, the sets of TNFA
+  states the parallel matcher would have active at each position can be
+  cached as DFA states.  Each DFA state holds a transition table that is
+  filled in on first use, so the DFA is only ever built for the parts
+  of it that the inputs actually reach.
+
+  The same DFA serves regex sets, whose TNFA has one final state per
+  regex.  A DFA state lists the regexes whose final states it contains,
+  so that a single pass over the string finds all of the regexes that
+  match.
+
+  The parallel matcher reads one character past a match that only the
+  initial states reached, and fails if that character is invalid, so a
+  state records which final states were reached by consuming a
+  character and which only by starting a new match.  The former are
+  kept as a bit per regex after the state set.
+
+  Transition assertions look at the character consumed and at the one
+  following it, so the latter is reduced to one of a few classes that
+  cover everything the assertions can distinguish, and the table is
+  indexed by both.  Characters outside the table are still handled, by
+  computing the transition every time.
+
+  The tables are shared by all threads matching against the regex.
+  Readers follow them without locking; filling in a missing transition
+  happens under the DFA's lock, and a state is fully built before any
+  pointer to it is published.  Once the states exceed TRE_DFA_MAX_BYTES
+  the DFA of a regex is abandoned for good, and the TNFA matchers are
+  used instead.
+
+  The states a regex set goes through are far more varied, so its
+  budget is raised to hold TRE_DFA_SET_STATES states, up to
+  TRE_DFA_SET_MAX_BYTES, and when that is exhausted all the states are
+  dropped and the DFA is built anew.  The dropped states are freed only
+  once no regsetexec call can still be following them, which `readers'
+  keeps track of; until then a call that exhausts the budget again
+  computes the state sets without caching them.
+
+  If the budget keeps running out after only a few calls, the strings
+  lead to new states all the time and building them costs more than
+  matching the regexes one by one.  Such a set is marked as thrashing,
+  and regsetexec then runs each regex on its own, most of them ruled
+  out by their required strings.  The regexes are compiled on their
+  own the first time this happens.  After TRE_DFA_SET_RETRY_CALLS
+  such calls the DFA is tried again, and each time it thrashes again
+  the wait doubles, up to TRE_DFA_SET_MAX_RETRY_CALLS, until a run of
+  the DFA lasts long enough.
+*/
+
+#define TRE_DFA_CHARS 128
+#define TRE_DFA_HASH 64
+#define TRE_DFA_MAX_BYTES (128*1024)
+#define TRE_DFA_SET_STATES 4096
+#define TRE_DFA_SET_MAX_BYTES (8*1024*1024)
+#define TRE_DFA_SET_MIN_CALLS 4096
+#define TRE_DFA_SET_MAX_SHORT 2
+#define TRE_DFA_SET_RETRY_CALLS 16384
+#define TRE_DFA_SET_MAX_RETRY_CALLS (1 << 24)
+
+#define TRE_DFA_BITS (8*sizeof(unsigned))
+#define TRE_DFA_WORDS(n) (((n) + TRE_DFA_BITS - 1) / TRE_DFA_BITS)
+#define TRE_DFA_TEST(set, i) ((set)[(i) / TRE_DFA_BITS] >> (i) % TRE_DFA_BITS & 1)
+#define TRE_DFA_SET(set, i) ((set)[(i) / TRE_DFA_BITS] |= 1U << (i) % TRE_DFA_BITS)
+
+/* Classes of the character following a position. */
+enum {
+  TRE_DFA_NUL,
+  TRE_DFA_NUL_NOTEOL,
+  TRE_DFA_NEWLINE,
+  TRE_DFA_WORD,
+  TRE_DFA_OTHER,
+  TRE_DFA_NCLASS
+};
+
+typedef struct tre_dfa_state tre_dfa_state_t;
+
+struct tre_dfa_state {
+  tre_dfa_state_t *chain;
+  tre_dfa_state_t *hnext;
+  unsigned hash;
+  unsigned gen;
+  /* 2 if a final state was reached by consuming a character, 1 if only
+     by starting a new match, 0 if none was reached. */
+  int final;
+  int dead;
+  /* The regexes whose final states were reached by consuming a
+     character, then the others reached, each list ending with -1. */
+  int *matches;
+  tre_dfa_state_t *volatile *trans;
+  unsigned set[];
+};
+
+struct tre_dfa {
+  volatile int lock[1];
+  volatile int failed;
+  volatile int readers;
+  volatile int calls;
+  volatile int thrashing;
+  volatile int member_calls;
+  volatile int members;
+  unsigned flush_calls;
+  int short_runs;
+  int retry_calls;
+  unsigned gen;
+  int nclass;
+  int anchored;
+  int init_assertions;
+  int num_regexes;
+  size_t set_words;
+  size_t words;
+  size_t size;
+  size_t max_size;
+  tre_tnfa_transition_t **states;
+  /* The regex of each final state, indexed by state id. */
+  int *regex;
+  unsigned *finals;
+  unsigned *init_mask;
+  unsigned *volatile *init_next;
+  unsigned *scratch;
+  tre_dfa_state_t *all;
+  tre_dfa_state_t *dropped;
+  tre_dfa_state_t *hash[TRE_DFA_HASH];
+  tre_dfa_state_t *volatile start[2][TRE_DFA_NCLASS];
+};
+
+#define TRE_DFA_LOOKAHEAD \
+  (ASSERT_AT_EOL | ASSERT_AT_BOW | ASSERT_AT_EOW | ASSERT_AT_WB \
+   | ASSERT_AT_WB_NEG)
+
+static void
+tre_dfa_free_states(tre_dfa_state_t *s)
+{
+  tre_dfa_state_t *next;
+  for (; s; s = next)
+    {
+      next = s->chain;
+      xfree(s);
+    }
+}
+
+void
+tre_dfa_free(tre_dfa_t *dfa)
+{
+  size_t i;
+  tre_dfa_free_states(dfa->all);
+  tre_dfa_free_states(dfa->dropped);
+  if (dfa->init_next)
+    {
+      for (i = 0; i < TRE_DFA_CHARS * dfa->nclass; i++)
+	xfree(dfa->init_next[i]);
+      xfree((void *)dfa->init_next);
+    }
+  xfree(dfa);
+}
+
+static tre_dfa_t *
+tre_dfa_new(const tre_tnfa_t *tnfa)
+{
+  tre_dfa_t *dfa;
+  tre_tnfa_transition_t *trans_i;
+  int num_regexes = tnfa->num_finals ? tnfa->num_finals : 1;
+  size_t set_words = TRE_DFA_WORDS(tnfa->num_states);
+  size_t words = set_words + TRE_DFA_WORDS(num_regexes);
+  size_t state_size;
+  unsigned int i;
+  int lookahead = 0, anchored = 1;
+
+  dfa = xcalloc(1, sizeof(*dfa) + tnfa->num_states * sizeof(*dfa->states)
+		+ tnfa->num_states * sizeof(*dfa->regex)
+		+ (2 * set_words + words) * sizeof(*dfa->scratch));
+  if (dfa == NULL)
+    return NULL;
+  dfa->states = (void *)(dfa + 1);
+  dfa->regex = (void *)(dfa->states + tnfa->num_states);
+  dfa->finals = (void *)(dfa->regex + tnfa->num_states);
+  dfa->init_mask = dfa->finals + set_words;
+  dfa->scratch = dfa->init_mask + set_words;
+  dfa->num_regexes = num_regexes;
+  dfa->set_words = set_words;
+  dfa->words = words;
+
+  for (i = 0; i < tnfa->num_transitions; i++)
+    {
+      trans_i = &tnfa->transitions[i];
+      if (!trans_i->state)
+	continue;
+      dfa->states[trans_i->state_id] = trans_i->state;
+      if (trans_i->state == tnfa->final)
+	TRE_DFA_SET(dfa->finals, trans_i->state_id);
+      lookahead |= trans_i->assertions & TRE_DFA_LOOKAHEAD;
+    }
+  for (trans_i = tnfa->initial; trans_i->state; trans_i++)
+    {
+      dfa->states[trans_i->state_id] = trans_i->state;
+      if (trans_i->state == tnfa->final)
+	TRE_DFA_SET(dfa->finals, trans_i->state_id);
+      lookahead |= trans_i->assertions & TRE_DFA_LOOKAHEAD;
+      if (!(trans_i->assertions & ASSERT_AT_BOL))
+	anchored = 0;
+      if (!trans_i->assertions)
+	TRE_DFA_SET(dfa->init_mask, trans_i->state_id);
+      else
+	dfa->init_assertions = 1;
+    }
+  for (i = 0; i < tnfa->num_finals; i++)
+    {
+      TRE_DFA_SET(dfa->finals, tnfa->final_ids[i]);
+      dfa->regex[tnfa->final_ids[i]] = i;
+    }
+
+  dfa->nclass = lookahead ? TRE_DFA_NCLASS : 1;
+  dfa->anchored = anchored && !(tnfa->cflags & REG_NEWLINE);
+
+  state_size = sizeof(tre_dfa_state_t) + words * sizeof(unsigned)
+    + TRE_DFA_CHARS * dfa->nclass * sizeof(tre_dfa_state_t *);
+  dfa->max_size = TRE_DFA_MAX_BYTES;
+  if (tnfa->num_finals)
+    {
+      if (dfa->max_size / TRE_DFA_SET_STATES < state_size)
+	dfa->max_size = TRE_DFA_SET_STATES * state_size;
+      if (dfa->max_size > TRE_DFA_SET_MAX_BYTES)
+	dfa->max_size = TRE_DFA_SET_MAX_BYTES;
+      dfa->init_next = xcalloc(TRE_DFA_CHARS * dfa->nclass,
+			       sizeof(*dfa->init_next));
+      if (dfa->init_next == NULL)
+	{
+	  xfree(dfa);
+	  return NULL;
+	}
+    }
+  return dfa;
+}
+
+static tre_dfa_t *
+tre_dfa_get(tre_tnfa_t *tnfa)
+{
+  tre_dfa_t *dfa = tnfa->dfa;
+
+  if (dfa == NULL)
+    {
+      dfa = tre_dfa_new(tnfa);
+      if (dfa == NULL)
+	return NULL;
+      if (a_cas_p(&tnfa->dfa, 0, dfa))
+	{
+	  tre_dfa_free(dfa);
+	  dfa = tnfa->dfa;
+	}
+    }
+  return dfa;
+}
+
+static int
+tre_dfa_class(const tre_dfa_t *dfa, tre_char_t c, int noteol)
+{
+  if (dfa->nclass == 1)
+    return 0;
+  if (c == L'\0')
+    return noteol ? TRE_DFA_NUL_NOTEOL : TRE_DFA_NUL;
+  if (c == L'\n')
+    return TRE_DFA_NEWLINE;
+  return IS_WORD_CHAR(c) ? TRE_DFA_WORD : TRE_DFA_OTHER;
+}
+
+/* Calls `f' with the regex of each final state in `set', and whether it
+   was reached by consuming a character. */
+#define TRE_DFA_FOR_FINALS(dfa, set, f) do {				      \
+    size_t i_;								      \
+    unsigned bits_;							      \
+    int id_, re_;							      \
+    for (i_ = 0; i_ < (dfa)->set_words; i_++)				      \
+      for (bits_ = (set)[i_] & (dfa)->finals[i_]; bits_; bits_ &= bits_ - 1) \
+	{								      \
+	  id_ = i_ * TRE_DFA_BITS + a_ctz_32(bits_);			      \
+	  re_ = (dfa)->regex[id_];					      \
+	  f(re_, TRE_DFA_TEST((set) + (dfa)->set_words, re_));		      \
+	}								      \
+  } while (0)
+
+/* Adds to `set' the states reached from those in `from' but not in
+   `skip' by consuming `prev_c' when the next character is of class
+   `k'. */
+static void
+tre_dfa_follow(const tre_tnfa_t *tnfa, const tre_dfa_t *dfa,
+	       const unsigned *from, const unsigned *skip, unsigned *set,
+	       tre_char_t prev_c, int k)
+{
+  static const tre_char_t class_chars[] = { 0, 0, L'\n', L'a', L' ' };
+  tre_char_t next_c = class_chars[k];
+  int reg_notbol = 0, reg_noteol = k == TRE_DFA_NUL_NOTEOL;
+  int reg_newline = tnfa->cflags & REG_NEWLINE;
+  regoff_t pos = 1;
+  tre_tnfa_transition_t *trans_i;
+  unsigned bits;
+  size_t i;
+  int id;
+
+  for (i = 0; i < dfa->set_words; i++)
+    for (bits = from[i] & ~(skip ? skip[i] : 0); bits; bits &= bits - 1)
+      {
+	id = i * TRE_DFA_BITS + a_ctz_32(bits);
+	for (trans_i = dfa->states[id]; trans_i->state; trans_i++)
+	  {
+	    if (trans_i->code_min > (tre_cint_t)prev_c
+		|| trans_i->code_max < (tre_cint_t)prev_c)
+	      continue;
+	    if (trans_i->assertions
+		&& (CHECK_ASSERTIONS(trans_i->assertions)
+		    || CHECK_CHAR_CLASSES(trans_i, tnfa, 0)))
+	      continue;
+	    TRE_DFA_SET(set, trans_i->state_id);
+	  }
+      }
+}
+
+/* Computes into `set' the state set reached from `from' by consuming
+   `prev_c' when the next character is of class `k', or the start set if
+   `from' is NULL.
+
+   Every state set of an unanchored regex set contains the initial
+   states without assertions, and following all of them is what makes
+   computing a state slow for large sets.  So what they lead to is kept
+   in `init_next' for each character in the transition tables, filled
+   in when `locked' is nonzero. */
+static void
+tre_dfa_compute(const tre_tnfa_t *tnfa, tre_dfa_t *dfa,
+		const unsigned *from, unsigned *set, tre_char_t prev_c,
+		int k, int reg_notbol, int locked)
+{
+  static const tre_char_t class_chars[] = { 0, 0, L'\n', L'a', L' ' };
+  tre_char_t next_c = class_chars[k];
+  int reg_noteol = k == TRE_DFA_NUL_NOTEOL;
+  int reg_newline = tnfa->cflags & REG_NEWLINE;
+  regoff_t pos = from != NULL;
+  tre_tnfa_transition_t *trans_i;
+  unsigned bits, *init = NULL;
+  size_t i, words = dfa->set_words;
+  int id;
+
+  if (from && dfa->init_next && (tre_cint_t)prev_c < TRE_DFA_CHARS)
+    {
+      init = dfa->init_next[prev_c * dfa->nclass + k];
+      if (init == NULL && locked)
+	{
+	  init = xcalloc(words, sizeof(*init));
+	  if (init != NULL)
+	    {
+	      tre_dfa_follow(tnfa, dfa, dfa->init_mask, NULL, init, prev_c, k);
+	      a_barrier();
+	      dfa->init_next[prev_c * dfa->nclass + k] = init;
+	    }
+	}
+    }
+
+  memset(set, 0, dfa->words * sizeof(*set));
+  if (from)
+    {
+      tre_dfa_follow(tnfa, dfa, from, init ? dfa->init_mask : NULL, set,
+		     prev_c, k);
+      if (init)
+	for (i = 0; i < words; i++)
+	  set[i] |= init[i];
+    }
+  for (i = 0; i < words; i++)
+    for (bits = set[i] & dfa->finals[i]; bits; bits &= bits - 1)
+      {
+	id = i * TRE_DFA_BITS + a_ctz_32(bits);
+	TRE_DFA_SET(set + words, dfa->regex[id]);
+      }
+  for (i = 0; i < words; i++)
+    set[i] |= dfa->init_mask[i];
+  if (dfa->init_assertions)
+    for (trans_i = tnfa->initial; trans_i->state; trans_i++)
+      {
+	if (trans_i->assertions && !CHECK_ASSERTIONS(trans_i->assertions))
+	  TRE_DFA_SET(set, trans_i->state_id);
+      }
+}
+
+static int
+tre_dfa_empty(const tre_dfa_t *dfa, const unsigned *set)
+{
+  size_t i;
+  for (i = 0; i < dfa->set_words; i++)
+    if (set[i])
+      return 0;
+  return 1;
+}
+
+/* Returns the state for the set in dfa->scratch, adding it if new, or
+   NULL if that would exceed the memory budget.  Called with the lock
+   held. */
+static tre_dfa_state_t *
+tre_dfa_intern(tre_dfa_t *dfa)
+{
+  tre_dfa_state_t *s;
+  size_t i, size, words = dfa->words;
+  unsigned *set = dfa->scratch, h = 0;
+  int n = 0, step = 0, *p, *q;
+
+  for (i = 0; i < words; i++)
+    h = (h ^ set[i]) * 0x01000193;
+  for (s = dfa->hash[h % TRE_DFA_HASH]; s; s = s->hnext)
+    if (s->hash == h && !memcmp(s->set, set, words * sizeof(*set)))
+      return s;
+
+#define COUNT(re, stepped) (n++, step += (stepped))
+  TRE_DFA_FOR_FINALS(dfa, set, COUNT);
+#undef COUNT
+
+  size = sizeof(*s) + words * sizeof(*set) + (n + 2) * sizeof(*s->matches);
+  size += ALIGN(size, tre_dfa_state_t *);
+  size += TRE_DFA_CHARS * dfa->nclass * sizeof(*s->trans);
+  if (size > dfa->max_size - dfa->size)
+    return NULL;
+  s = xcalloc(1, size);
+  if (s == NULL)
+    return NULL;
+  dfa->size += size;
+
+  memcpy(s->set, set, words * sizeof(*set));
+  s->matches = (void *)(s->set + words);
+  p = s->matches;
+  q = s->matches + step + 1;
+#define LIST(re, stepped) (*((stepped) ? p++ : q++) = (re))
+  TRE_DFA_FOR_FINALS(dfa, set, LIST);
+#undef LIST
+  *p = *q = -1;
+  s->trans = (void *)((char *)s + size
+		      - TRE_DFA_CHARS * dfa->nclass * sizeof(*s->trans));
+  s->hash = h;
+  s->gen = dfa->gen;
+  s->final = step ? 2 : n ? 1 : 0;
+  s->dead = dfa->anchored && tre_dfa_empty(dfa, set);
+  s->hnext = dfa->hash[h % TRE_DFA_HASH];
+  dfa->hash[h % TRE_DFA_HASH] = s;
+  s->chain = dfa->all;
+  dfa->all = s;
+  return s;
+}
+
+/* Computes the state reached from `from' by consuming `prev_c' when the
+   next character is of class `k', or the start state if `from' is NULL,
+   and caches it in the appropriate table.  Returns NULL if the DFA has
+   been abandoned. */
+static tre_dfa_state_t *
+tre_dfa_step(const tre_tnfa_t *tnfa, tre_dfa_t *dfa, tre_dfa_state_t *from,
+	     tre_char_t prev_c, int k, int reg_notbol)
+{
+  tre_dfa_state_t *s;
+  int current;
+
+  LOCK(dfa->lock);
+  if (dfa->failed)
+    {
+      UNLOCK(dfa->lock);
+      return NULL;
+    }
+  current = !from || from->gen == dfa->gen;
+
+  /* The caller being the only reader, and not in a dropped state, no
+     one can reach the dropped states any more. */
+  if (dfa->dropped && current && dfa->readers == 1)
+    {
+      tre_dfa_free_states(dfa->dropped);
+      dfa->dropped = NULL;
+    }
+
+  tre_dfa_compute(tnfa, dfa, from ? from->set : NULL, dfa->scratch,
+		  prev_c, k, reg_notbol, 1);
+  s = tre_dfa_intern(dfa);
+  if (s == NULL && tnfa->num_finals)
+    {
+      if (dfa->dropped)
+	{
+	  UNLOCK(dfa->lock);
+	  return NULL;
+	}
+      if ((unsigned)dfa->calls - dfa->flush_calls < TRE_DFA_SET_MIN_CALLS)
+	{
+	  if (++dfa->short_runs >= TRE_DFA_SET_MAX_SHORT)
+	    {
+	      dfa->short_runs = 0;
+	      dfa->retry_calls = !dfa->retry_calls ? TRE_DFA_SET_RETRY_CALLS
+		: dfa->retry_calls < TRE_DFA_SET_MAX_RETRY_CALLS
+		? 2 * dfa->retry_calls : dfa->retry_calls;
+	      dfa->member_calls = 0;
+	      dfa->thrashing = 1;
+	    }
+	}
+      else
+	{
+	  dfa->short_runs = 0;
+	  dfa->retry_calls = 0;
+	}
+      dfa->flush_calls = dfa->calls;
+      dfa->dropped = dfa->all;
+      dfa->all = NULL;
+      dfa->size = 0;
+      dfa->gen++;
+      current = 0;
+      memset(dfa->hash, 0, sizeof(dfa->hash));
+      memset((void *)dfa->start, 0, sizeof(dfa->start));
+      s = tre_dfa_intern(dfa);
+    }
+  if (s == NULL)
+    {
+      dfa->failed = 1;
+    }
+  else
+    {
+      a_barrier();
+      if (!from)
+	dfa->start[reg_notbol][k] = s;
+      else if ((tre_cint_t)prev_c < TRE_DFA_CHARS && current)
+	from->trans[prev_c * dfa->nclass + k] = s;
+    }
+  UNLOCK(dfa->lock);
+  return s;
+}
+
+#define GET_NEXT_DFA_CHAR() do {                                              \
+    if (*str_byte < 128) next_c = *str_byte++;                                \
+    else if ((len = mbtowc(&next_c, (const void *)str_byte, MB_LEN_MAX)) < 0) \
+      goto done;                                                              \
+    else str_byte += len;                                                     \
+  } while (0)
+
+#define MARK(re) do {                                                         \
+    if (!TRE_DFA_TEST(matched, re))                                           \
+      {                                                                       \
+	TRE_DFA_SET(matched, re);                                             \
+	n++;                                                                  \
+      }                                                                       \
+  } while (0)
+
+/* Marks in `matched' the regexes that match `string' exactly as
+   tre_tnfa_run_parallel would decide it without tags, and returns how
+   many were not marked before, or -1 if the DFA cannot be used.  Stops
+   as soon as all of the regexes are marked. */
+static int
+tre_dfa_run(tre_tnfa_t *tnfa, const char *string, int eflags,
+	    unsigned *matched)
+{
+  tre_dfa_t *dfa = tre_dfa_get(tnfa);
+  tre_dfa_state_t *s, *next;
+  const unsigned char *str_byte = (const void *)string;
+  tre_char_t c, next_c;
+  int reg_notbol = !!(eflags & REG_NOTBOL);
+  int reg_noteol = eflags & REG_NOTEOL;
+  int k, len, n = 0, *p, *pending;
+
+  if (dfa == NULL || dfa->failed)
+    return -1;
+
+  GET_NEXT_DFA_CHAR();
+  k = tre_dfa_class(dfa, next_c, reg_noteol);
+  s = dfa->start[reg_notbol][k];
+  if (s == NULL && !(s = tre_dfa_step(tnfa, dfa, NULL, 0, k, reg_notbol)))
+    return -1;
+
+  for (;;)
+    {
+      pending = NULL;
+      if (s->final)
+	{
+	  for (p = s->matches; *p >= 0; p++)
+	    MARK(*p);
+	  if (n == dfa->num_regexes)
+	    break;
+	  if (p[1] >= 0)
+	    pending = p + 1;
+	}
+      if (!next_c)
+	{
+	  for (; pending && *pending >= 0; pending++)
+	    MARK(*pending);
+	  break;
+	}
+      if (s->dead)
+	break;
+      c = next_c;
+      GET_NEXT_DFA_CHAR();
+      if (pending)
+	{
+	  for (; *pending >= 0; pending++)
+	    MARK(*pending);
+	  if (n == dfa->num_regexes)
+	    break;
+	}
+      k = tre_dfa_class(dfa, next_c, reg_noteol);
+      if ((tre_cint_t)c < TRE_DFA_CHARS
+	  && (next = s->trans[c * dfa->nclass + k]))
+	s = next;
+      else if (!(s = tre_dfa_step(tnfa, dfa, s, c, k, 0)))
+	return -1;
+    }
+ done:
+  return n;
+}
+
+/* Like tre_dfa_run, but computes every state set afresh, for when the
+   DFA of a regex set has been abandoned.  Returns -1 if out of
+   memory. */
+static int
+tre_dfa_run_uncached(tre_tnfa_t *tnfa, const char *string, int eflags,
+		     unsigned *matched)
+{
+  tre_dfa_t *dfa = tre_dfa_get(tnfa);
+  const unsigned char *str_byte = (const void *)string;
+  unsigned *buf, *set, *tmp, *swap;
+  tre_char_t c, next_c;
+  int reg_notbol = !!(eflags & REG_NOTBOL);
+  int reg_noteol = eflags & REG_NOTEOL;
+  int k, len, n = 0;
+
+  if (dfa == NULL)
+    return -1;
+  buf = xmalloc(2 * dfa->words * sizeof(*buf));
+  if (buf == NULL)
+    return -1;
+  set = buf;
+  tmp = buf + dfa->words;
+
+#define MARK_STEPPED(re, stepped) do { if (stepped) MARK(re); } while (0)
+#define MARK_PENDING(re, stepped) do { if (!(stepped)) MARK(re); } while (0)
+  GET_NEXT_DFA_CHAR();
+  k = tre_dfa_class(dfa, next_c, reg_noteol);
+  tre_dfa_compute(tnfa, dfa, NULL, set, 0, k, reg_notbol, 0);
+  for (;;)
+    {
+      TRE_DFA_FOR_FINALS(dfa, set, MARK_STEPPED);
+      if (n == dfa->num_regexes)
+	break;
+      if (!next_c)
+	{
+	  TRE_DFA_FOR_FINALS(dfa, set, MARK_PENDING);
+	  break;
+	}
+      if (dfa->anchored && tre_dfa_empty(dfa, set))
+	break;
+      c = next_c;
+      GET_NEXT_DFA_CHAR();
+      TRE_DFA_FOR_FINALS(dfa, set, MARK_PENDING);
+      if (n == dfa->num_regexes)
+	break;
+      k = tre_dfa_class(dfa, next_c, reg_noteol);
+      tre_dfa_compute(tnfa, dfa, set, tmp, c, k, 0, 0);
+      swap = set;
+      set = tmp;
+      tmp = swap;
+    }
+#undef MARK_STEPPED
+#undef MARK_PENDING
+ done:
+  xfree(buf);
+  return n;
+}
+
+#undef MARK
+
+/***********************************************************************
+ Prefilters
+***********************************************************************/
+
+/* Returns the offset of the first position at which a match could start,
+   going by the characters that can start one, or -1 if there is none.
+   Multibyte characters are never skipped over, so that an invalid one
+   still fails the match as it would have without skipping. */
+static regoff_t
+tre_skip_to_first(const tre_tnfa_t *tnfa, const char *string)
+{
+  const unsigned char *s = (const void *)string;
+  const char *set = tnfa->firstpos_chars;
+  int mb = MB_CUR_MAX > 1;
+
+  if (tnfa->first_char >= 0 && !mb && !set[128])
+    {
+      const char *p = strchr(string, tnfa->first_char);
+      return p ? p - string : -1;
+    }
+  for (; *s; s++)
+    if (set[*s] || (*s >= 128 && mb))
+      return (const char *)s - string;
+  return -1;
+}
+
+enum { TRE_SET_MEMBERS_NONE, TRE_SET_MEMBERS_BUSY, TRE_SET_MEMBERS_READY,
+       TRE_SET_MEMBERS_FAILED };
+
+/* Compiles the regexes of a set one by one, the first time the set is
+   found thrashing, and returns whether they are ready.  A single caller
+   compiles them; the others keep using the DFA meanwhile, and for good
+   if compiling fails. */
+static int
+tre_set_members(tre_tnfa_t *tnfa, tre_dfa_t *dfa)
+{
+  regex_t *members;
+  int *keys;
+  const char *p = tnfa->member_patterns, *req;
+  size_t i;
+
+  if (dfa->members == TRE_SET_MEMBERS_READY)
+    return 1;
+  if (a_cas(&dfa->members, TRE_SET_MEMBERS_NONE, TRE_SET_MEMBERS_BUSY)
+      != TRE_SET_MEMBERS_NONE)
+    return 0;
+  members = xcalloc(tnfa->num_finals, sizeof(*members));
+  keys = xmalloc(tnfa->num_finals * sizeof(*keys));
+  for (i = 0; members && keys && i < tnfa->num_finals; i++)
+    {
+      if (regcomp(&members[i], p, tnfa->cflags) != REG_OK)
+	break;
+      req = ((tre_tnfa_t *)members[i].TRE_REGEX_T_FIELD)->required_chars;
+      keys[i] = req && req[0] && req[1] ? TRE_SET_KEY(req[0], req[1]) : -1;
+      p += strlen(p) + 1;
+    }
+  if (members == NULL || keys == NULL || i < tnfa->num_finals)
+    {
+      while (members && i--)
+	regfree(&members[i]);
+      xfree(members);
+      xfree(keys);
+      dfa->members = TRE_SET_MEMBERS_FAILED;
+      return 0;
+    }
+  tnfa->members = members;
+  tnfa->member_keys = keys;
+  a_barrier();
+  dfa->members = TRE_SET_MEMBERS_READY;
+  return 1;
+}
+
+/* Marks in `matched' the regexes of a set that match `string', trying
+   them one by one, and returns how many there are, or -1 on error.
+   A regex is skipped without a search if the first two bytes of its
+   required string do not occur in `string'.  Stops once `nids'
+   matches, or one if `nids' is 0, are known, since only the first
+   ones are reported. */
+static int
+tre_set_run_members(const tre_tnfa_t *tnfa, const char *string, int eflags,
+		    unsigned *matched, size_t nids)
+{
+  const unsigned char *s = (const void *)string;
+  unsigned keys[TRE_DFA_WORDS(TRE_SET_KEYS)] = { 0 };
+  size_t i, n = 0;
+
+  if (*s)
+    for (; s[1]; s++)
+      TRE_DFA_SET(keys, TRE_SET_KEY(s[0], s[1]));
+  for (i = 0; i < tnfa->num_finals; i++)
+    {
+      if (tnfa->member_keys[i] >= 0
+	  && !TRE_DFA_TEST(keys, tnfa->member_keys[i]))
+	continue;
+      switch (regexec(&tnfa->members[i], string, 0, NULL, eflags))
+	{
+	case REG_OK:
+	  TRE_DFA_SET(matched, i);
+	  if (++n >= nids)
+	    return n;
+	  break;
+	case REG_NOMATCH:
+	  break;
+	default:
+	  return -1;
+	}
+    }
+  return n;
+}
+
 /***********************************************************************
  from regexec.c
 ***********************************************************************/
@@ -998,8 +1776,34 @@ regexec(const regex_t *restrict preg, const char *restrict string,
 {
   tre_tnfa_t *tnfa = (void *)preg->TRE_REGEX_T_FIELD;
   reg_errcode_t status;
-  regoff_t *tags = NULL, eo;
+  regoff_t *tags = NULL, eo, skip = 0;
+  size_t i;
   if (tnfa->cflags & REG_NOSUB) nmatch = 0;
+
+  /* Rule out strings lacking a substring every match contains, and
+     skip ahead to where a match could start. */
+  if (tnfa->required_chars && !strstr(string, tnfa->required_chars))
+    return REG_NOMATCH;
+  if (tnfa->firstpos_chars && !tnfa->have_backrefs)
+    {
+      skip = tre_skip_to_first(tnfa, string);
+      if (skip < 0)
+	return REG_NOMATCH;
+      string += skip;
+    }
+
+  /* Without back references, the lazy DFA decides whether there is a
+     match at all, so the TNFA is only run to find submatches. */
+  if (!tnfa->have_backrefs)
+    {
+      unsigned matched = 0;
+      int n = tre_dfa_run(tnfa, string, eflags, &matched);
+      if (n == 0)
+	return REG_NOMATCH;
+      if (n > 0 && nmatch == 0)
+	return REG_OK;
+    }
+
   if (tnfa->num_tags > 0 && nmatch > 0)
     {
       tags = xmalloc(sizeof(*tags) * tnfa->num_tags);
@@ -1020,9 +1824,75 @@ regexec(const regex_t *restrict preg, const char *restrict string,
     }
 
   if (status == REG_OK)
-    /* A match was found, so fill the submatch registers. */
-    tre_fill_pmatch(nmatch, pmatch, tnfa->cflags, tnfa, tags, eo);
+    {
+      /* A match was found, so fill the submatch registers. */
+      tre_fill_pmatch(nmatch, pmatch, tnfa->cflags, tnfa, tags, eo);
+      if (skip)
+	for (i = 0; i < nmatch; i++)
+	  if (pmatch[i].rm_so >= 0)
+	    {
+	      pmatch[i].rm_so += skip;
+	      pmatch[i].rm_eo += skip;
+	    }
+    }
   if (tags)
     xfree(tags);
   return status;
 }
+
+int
+regsetexec(const regset_t *restrict set, const char *restrict string,
+	   size_t nids, size_t ids[restrict], int eflags)
+{
+  tre_tnfa_t *tnfa = set->__opaque;
+  unsigned buf[32], *matched = buf;
+  size_t words = TRE_DFA_WORDS(set->re_nset), i, j;
+  tre_dfa_t *dfa = tre_dfa_get(tnfa);
+  regoff_t skip;
+  int n = 0;
+
+  if (dfa == NULL)
+    return REG_ESPACE;
+  if (words > sizeof(buf) / sizeof(*buf))
+    {
+      matched = xcalloc(words, sizeof(*matched));
+      if (matched == NULL)
+	return REG_ESPACE;
+    }
+  else
+    memset(buf, 0, sizeof(buf));
+
+  if (dfa->thrashing && tre_set_members(tnfa, dfa))
+    {
+      /* Give the DFA another try once enough calls went this way. */
+      if (a_fetch_add(&dfa->member_calls, 1) == dfa->retry_calls)
+	dfa->thrashing = 0;
+      n = tre_set_run_members(tnfa, string, eflags, matched, nids);
+      goto report;
+    }
+  skip = tnfa->firstpos_chars ? tre_skip_to_first(tnfa, string) : 0;
+  if (skip >= 0)
+    {
+      a_inc(&dfa->calls);
+      a_inc(&dfa->readers);
+      n = tre_dfa_run(tnfa, string + skip, eflags, matched);
+      a_dec(&dfa->readers);
+      if (n < 0)
+	{
+	  memset(matched, 0, words * sizeof(*matched));
+	  n = tre_dfa_run_uncached(tnfa, string + skip, eflags, matched);
+	}
+    }
+
+  /* Report the matching regexes in ascending order. */
+ report:
+  for (i = j = 0; n > 0 && i < set->re_nset && j < nids; i++)
+    if (TRE_DFA_TEST(matched, i))
+      ids[j++] = i;
+  for (; j < nids; j++)
+    ids[j] = (size_t)-1;
+
+  if (matched != buf)
+    xfree(matched);
+  return n < 0 ? REG_ESPACE : n ? REG_OK : REG_NOMATCH;
+}
@@ -146,6 +146,13 @@ struct tre_submatch_data {
 typedef struct tre_submatch_data tre_submatch_data_t;
 
 
+/* Lazily built DFA, see regexec.c. */
+typedef struct tre_dfa tre_dfa_t;
+
+#define TRE_SET_KEYS 4096
+#define TRE_SET_KEY(a, b) \
+  (((unsigned char)(a) << 4 ^ (unsigned char)(b)) % TRE_SET_KEYS)
+
 /* TNFA definition. */
 typedef struct tnfa tre_tnfa_t;
 
@@ -154,8 +161,18 @@ struct tnfa {
   unsigned int num_transitions;
   tre_tnfa_transition_t *initial;
   tre_tnfa_transition_t *final;
+  int *final_ids;
+  unsigned int num_finals;
+  /* The patterns of a set, each terminated by a null byte.  Once the
+     set is found thrashing they are compiled on their own into
+     `members', with the key of the first two bytes of each required
+     string, or -1 if it has none, in `member_keys'. */
+  char *member_patterns;
+  regex_t *members;
+  int *member_keys;
   tre_submatch_data_t *submatch_data;
   char *firstpos_chars;
+  char *required_chars;
   int first_char;
   unsigned int num_submatches;
   tre_tag_direction_t *tag_directions;
@@ -167,8 +184,13 @@ struct tnfa {
   int cflags;
   int have_backrefs;
   int have_approx;
+  tre_dfa_t *volatile dfa;
 };
 
+#define tre_dfa_free __tre_dfa_free
+
+hidden void tre_dfa_free(tre_dfa_t *dfa);
+
 /* from tre-mem.h: */
 
 #define TRE_MEM_BLOCK_SIZE 1024
@@ -6,6 +6,7 @@
 #include <limits.h>
 #include <string.h>
 #include <stdint.h>
+#include <float.h>
 
 #include "stdio_impl.h"
 #include "shgetc.h"
@@ -41,6 +42,84 @@ static void store_int(void *dest, int size, unsigned long long i)
 	}
 }
 
+/* For F_STR files the byte at rend is always readable: it is either
+ * the terminating null or the start of the next chunk. These convert a
+ * field in place when it ends inside the current chunk, and return the
+ * number of bytes consumed, or 0 to leave the field to the general code
+ * (which also handles every error). */
+
+static size_t direct_int(const unsigned char *s, const unsigned char *e,
+	int width, int size, void *dest)
+{
+	const unsigned char *p = s;
+	unsigned long long x = 0;
+	int neg = 0, n;
+
+	if (*p=='+' || *p=='-') neg = *p++=='-';
+	for (n=0; p<e && *p-'0'<10U; p++, n++) x = 10*x + *p-'0';
+	if (!n || n>19 || p==e && *e || width && p-s > width) return 0;
+	store_int(dest, size, neg ? -x : x);
+	return p-s;
+}
+
+static size_t direct_float(const unsigned char *s, const unsigned char *e,
+	int width, int size, void *dest)
+{
+	const unsigned char *p = s;
+	uint64_t w = 0;
+	int neg = 0, eneg = 0, nd = 0, dexp = 0, ex = 0;
+	int gotdig = 0, gotrad = 0;
+	double y = 0;
+
+	if (size != SIZE_def && size != SIZE_l) return 0;
+	if (*p=='+' || *p=='-') neg = *p++=='-';
+	for (; p<e; p++) {
+		if (*p=='.' && !gotrad) {
+			gotrad = 1;
+			continue;
+		}
+		if (*p-'0' >= 10U) break;
+		gotdig = 1;
+		if (w || *p!='0') {
+			if (nd++ == 19) return 0;
+			w = 10*w + *p-'0';
+		}
+		dexp -= gotrad;
+	}
+	if (!gotdig || p<e && (*p|32)=='x') return 0;
+	if (p<e && (*p|32)=='e') {
+		p++;
+		if (p<e && (*p=='+' || *p=='-')) eneg = *p++=='-';
+		if (p==e || *p-'0' >= 10U) return 0;
+		for (; p<e && *p-'0'<10U; p++)
+			if (ex < 100000) ex = 10*ex + *p-'0';
+	}
+	if (p==e && *e || width && p-s > width) return 0;
+	/* __eisel_lemire declines outside round-to-nearest, so directed
+	 * rounding modes always reach the exact scanner. */
+	if (w && !__eisel_lemire(w, dexp + (eneg ? -ex : ex),
+	    size==SIZE_l ? DBL_MANT_DIG : FLT_MANT_DIG, &y))
+		return 0;
+	if (neg) y = -y;
+	if (dest) {
+		if (size==SIZE_l) *(double *)dest = y;
+		else *(float *)dest = y;
+	}
+	return p-s;
+}
+
+static size_t direct_str(const unsigned char *s, const unsigned char *e,
+	int width, char *dest)
+{
+	const unsigned char *p = s;
+	/* Copying as we go is harmless if the general code takes over. */
+	for (; p<e && !isspace(*p) && (!width || p-s < width); p++)
+		if (dest) dest[p-s] = *p;
+	if (p==s || p==e && *e && (!width || p-s < width)) return 0;
+	if (dest) dest[p-s] = 0;
+	return p-s;
+}
+
 static void *arg_n(va_list ap, unsigned int n)
 {
 	void *p;
@@ -85,6 +164,11 @@ int vfscanf(FILE *restrict f, const char *restrict fmt, va_list ap)
 
 		if (isspace(*p)) {
 			while (isspace(p[1])) p++;
+			if (f->flags & F_STR) {
+				while (f->rpos < f->rend && isspace(*f->rpos))
+					f->rpos++, pos++;
+				if (f->rpos < f->rend) continue;
+			}
 			shlim(f, 0);
 			while (isspace(shgetc(f)));
 			shunget(f);
@@ -92,6 +176,11 @@ int vfscanf(FILE *restrict f, const char *restrict fmt, va_list ap)
 			continue;
 		}
 		if (*p != '%' || p[1] == '%') {
+			if ((f->flags & F_STR) && *p != '%' && f->rpos < f->rend) {
+				if (*f->rpos != *p) goto match_fail;
+				f->rpos++, pos++;
+				continue;
+			}
 			shlim(f, 0);
 			if (*p == '%') {
 				p++;
@@ -180,12 +269,40 @@ int vfscanf(FILE *restrict f, const char *restrict fmt, va_list ap)
 			/* do not increment match count, etc! */
 			continue;
 		default:
+			if (f->flags & F_STR) {
+				while (f->rpos < f->rend && isspace(*f->rpos))
+					f->rpos++, pos++;
+				if (f->rpos < f->rend) break;
+			}
 			shlim(f, 0);
 			while (isspace(shgetc(f)));
 			shunget(f);
 			pos += shcnt(f);
 		}
 
+		if ((f->flags & F_STR) && f->rpos < f->rend && !alloc) {
+			size_t n = 0;
+			switch (t) {
+			case 'd': case 'u':
+				n = direct_int(f->rpos, f->rend, width, size, dest);
+				break;
+			case 'e': case 'f': case 'g':
+			case 'E': case 'F': case 'G':
+				n = direct_float(f->rpos, f->rend, width, size, dest);
+				break;
+			case 's':
+				if (size == SIZE_def)
+					n = direct_str(f->rpos, f->rend, width, dest);
+				break;
+			}
+			if (n) {
+				f->rpos += n;
+				pos += n;
+				if (dest) matches++;
+				continue;
+			}
+		}
+
 		shlim(f, width);
 		if (shgetc(f) < 0) goto input_fail;
 		shunget(f);
@@ -19,8 +19,13 @@ int vsscanf(const char *restrict s, const char *restrict fmt, va_list ap)
 {
 	FILE f = {
 		.buf = (void *)s, .cookie = (void *)s,
-		.read = string_read, .lock = -1
+		.read = string_read, .lock = -1, .flags = F_STR
 	};
+	/* Expose the first chunk before any conversion so that vfscanf
+	 * can work on it directly. */
+	char *end = memchr(s, 0, 256);
+	f.rpos = (void *)s;
+	f.rend = f.cookie = end ? end : (char *)s+256;
 	return vfscanf(&f, fmt, ap);
 }
 
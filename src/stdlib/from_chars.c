@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <endian.h>
+#include <math.h>
+#include <float.h>
+#include "shgetc.h"
+#include "floatscan.h"
+
+static int digitval(int c)
+{
+	if (c-'0' < 10U) return c-'0';
+	if ((c|32)-'a' < 26U) return (c|32)-'a'+10;
+	return 99;
+}
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+/* Convert 8 ASCII digits at once, combining adjacent pairs of digits,
+ * then pairs of pairs, with multiplications. */
+static int eight_digits(const char *s, uint64_t *v)
+{
+#ifdef __GNUC__
+	typedef uint64_t __attribute__((__may_alias__, __aligned__(1))) u64;
+	uint64_t x = *(const u64 *)s;
+#else
+	uint64_t x;
+	memcpy(&x, s, 8);
+#endif
+	if ((x & 0xf0f0f0f0f0f0f0f0) != 0x3030303030303030
+	 || (x + 0x0606060606060606 & 0xf0f0f0f0f0f0f0f0) != 0x3030303030303030)
+		return 0;
+	x -= 0x3030303030303030;
+	x = x*10 + (x>>8);
+	*v = ((x & 0x000000ff000000ff) * (100 + (1000000ULL<<32))
+		+ (x>>16 & 0x000000ff000000ff) * (1 + (10000ULL<<32))) >> 32;
+	return 1;
+}
+#endif
+
+static int scan_u(const char **p, const char *e, int base, unsigned long long *v)
+{
+	const char *s = *p;
+	unsigned long long x = 0, lim;
+	int d, ovf = 0;
+
+	if (base < 2 || base > 36) return EINVAL;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	/* Up to 16 decimal digits cannot overflow */
+	uint64_t y;
+	if (base == 10)
+		for (; e-s >= 8 && s-*p < 16 && eight_digits(s, &y); s += 8)
+			x = x*100000000 + y;
+#endif
+	lim = base==10 ? ULLONG_MAX/10 : ULLONG_MAX/base;
+	for (; s<e && (d=digitval(*s))<base; s++) {
+		if (x > lim || x*base > ULLONG_MAX-d) ovf = 1;
+		else x = x*base + d;
+	}
+	if (s == *p) return EINVAL;
+	*p = s;
+	*v = ovf ? ULLONG_MAX : x;
+	return ovf ? ERANGE : 0;
+}
+
+static size_t match(const char *s, const char *e, const char *w)
+{
+	size_t i;
+	for (i=0; w[i]; i++) if (s+i==e || (s[i]|32) != w[i]) return 0;
+	return i;
+}
+
+static int scan_f(const char **p, const char *e, int prec, long double *v)
+{
+	const char *s = *p, *t;
+	uint64_t w = 0;
+	long long ex = 0, q;
+	int neg, nd = 0, dexp = 0, gotdig = 0, gotrad = 0, trunc = 0;
+	double y, y1;
+	size_t l;
+
+	neg = s<e && *s=='-';
+	t = s += neg;
+
+	/* Accumulate up to 19 significant digits, keeping track of the
+	 * power of ten and whether nonzero digits were dropped. */
+	for (; s<e; s++) {
+		if (*s=='.' && !gotrad) {
+			gotrad = 1;
+			continue;
+		}
+		if (*s-'0' >= 10U) break;
+		gotdig = 1;
+		if (nd < 19) {
+			if (w || *s!='0') w = 10*w + *s-'0', nd++;
+			dexp -= gotrad;
+		} else {
+			dexp += !gotrad;
+			trunc |= *s!='0';
+		}
+	}
+
+	if (!gotdig) {
+		s = t;
+		if ((l = match(s, e, "infinity")) || (l = match(s, e, "inf"))) {
+			*p = s+l;
+			*v = neg ? -INFINITY : INFINITY;
+			return 0;
+		}
+		if (!match(s, e, "nan")) return EINVAL;
+		*p = s += 3;
+		if (s<e && *s=='(') {
+			for (s++; s<e && (isalnum((unsigned char)*s) || *s=='_'); s++);
+			if (s<e && *s==')') *p = s+1;
+		}
+		*v = neg ? -NAN : NAN;
+		return 0;
+	}
+
+	if (s<e && (*s|32)=='e') {
+		const char *u = s+1;
+		int eneg = u<e && *u=='-';
+		if (u<e && (*u=='+' || *u=='-')) u++;
+		if (u<e && *u-'0' < 10U) {
+			for (; u<e && *u-'0' < 10U; u++)
+				if (ex < 100000) ex = 10*ex + *u-'0';
+			if (eneg) ex = -ex;
+			s = u;
+		}
+	}
+
+	if (!w) {
+		*p = s;
+		*v = neg ? -0.0 : 0.0;
+		return 0;
+	}
+	q = dexp + ex;
+	/* The fast path only decides in round-to-nearest; directed modes
+	 * get the rounding of strtod from the exact algorithm below. */
+	if (prec < 2 && q >= INT_MIN && q <= INT_MAX) {
+		int bits = prec ? DBL_MANT_DIG : FLT_MANT_DIG;
+		if (__eisel_lemire(w, q, bits, &y)
+		 && (!trunc || __eisel_lemire(w+1, q, bits, &y1) && y1==y)) {
+			*p = s;
+			*v = neg ? -y : y;
+			return 0;
+		}
+	}
+
+	/* Hard cases go through the exact algorithm on a terminated copy
+	 * of the text that was just validated. */
+	char tmp[128], *b = tmp;
+	FILE f;
+	int r, old = errno;
+	l = s - (t-neg);
+	if (l >= sizeof tmp && !(b = malloc(l+1))) return ENOMEM;
+	*p = s;
+	memcpy(b, t-neg, l);
+	b[l] = 0;
+	errno = 0;
+	sh_fromstring(&f, b);
+	shlim(&f, 0);
+	*v = __floatscan(&f, prec, 1);
+	r = errno;
+	errno = old;
+	if (b != tmp) free(b);
+	return r;
+}
+
+/**
+ * @brief Parses an unsigned integer from a length-bounded buffer.
+ *
+ * No whitespace, sign or base prefix is accepted. On success `*p` is
+ * advanced past the digits. An out-of-range value is consumed and
+ * stored as ULLONG_MAX.
+ *
+ * @return 0, EINVAL if no digits were found, or ERANGE.
+ */
+int from_chars_ull(const char **p, const char *e, unsigned long long *v, int base)
+{
+	return scan_u(p, e, base, v);
+}
+
+/**
+ * @brief Parses a signed integer from a length-bounded buffer.
+ *
+ * Like from_chars_ull, but accepts a leading '-' and saturates to
+ * LLONG_MIN or LLONG_MAX.
+ */
+int from_chars_ll(const char **p, const char *e, long long *v, int base)
+{
+	const char *s = *p;
+	unsigned long long x;
+	int neg = s<e && *s=='-', r;
+
+	s += neg;
+	if ((r = scan_u(&s, e, base, &x)) == EINVAL) return r;
+	if (x > LLONG_MAX + (unsigned long long)neg) {
+		x = LLONG_MAX + (unsigned long long)neg;
+		r = ERANGE;
+	}
+	*v = neg ? -x : x;
+	*p = s;
+	return r;
+}
+
+/**
+ * @brief Parses a double from a length-bounded buffer.
+ *
+ * Accepts an optional '-', decimal digits with an optional radix point
+ * and exponent, or inf, infinity, nan and nan(...), independent of
+ * locale. Overflow and underflow store the same result as strtod and
+ * return ERANGE; errno is left unchanged.
+ */
+int from_chars_d(const char **p, const char *e, double *v)
+{
+	long double y;
+	int r = scan_f(p, e, 1, &y);
+	if (r != EINVAL && r != ENOMEM) *v = y;
+	return r;
+}
+
+int from_chars_f(const char **p, const char *e, float *v)
+{
+	long double y;
+	int r = scan_f(p, e, 0, &y);
+	if (r != EINVAL && r != ENOMEM) *v = y;
+	return r;
+}
+
+/**
+ * @brief Parses a delimited list of numbers into an array.
+ *
+ * Up to `n` numbers separated by `delim` are stored into `out`, whose
+ * element type is given by `type` (FROM_CHARS_LL, FROM_CHARS_ULL,
+ * FROM_CHARS_D or FROM_CHARS_F; integers are decimal). Whitespace other
+ * than the delimiter is allowed around numbers. Parsing stops at the
+ * first element that is missing or out of range.
+ *
+ * @return The number of elements stored. `*p` points just past the last
+ *         of them.
+ */
+size_t from_chars_array(const char **p, const char *e, int delim, int type, void *out, size_t n)
+{
+	const char *s = *p, *t;
+	size_t i;
+	int r;
+
+	for (i=0; i<n; i++) {
+		t = s;
+		if (i) {
+			while (t<e && *t!=delim && isspace((unsigned char)*t)) t++;
+			if (t==e || *t!=delim) break;
+			t++;
+		}
+		while (t<e && *t!=delim && isspace((unsigned char)*t)) t++;
+		switch (type) {
+		case FROM_CHARS_LL:
+			r = from_chars_ll(&t, e, (long long *)out+i, 10);
+			break;
+		case FROM_CHARS_ULL:
+			r = from_chars_ull(&t, e, (unsigned long long *)out+i, 10);
+			break;
+		case FROM_CHARS_D:
+			r = from_chars_d(&t, e, (double *)out+i);
+			break;
+		case FROM_CHARS_F:
+			r = from_chars_f(&t, e, (float *)out+i);
+			break;
+		default:
+			r = EINVAL;
+		}
+		if (r) break;
+		s = t;
+	}
+	*p = s;
+	return i;
+}
@@ -0,0 +1,37 @@
+#include <string.h>
+#include <stdint.h>
+#include "cpu.h"
+
+#if defined(__clang__) || __GNUC__ >= 5
+
+#define strlen __strlen_generic
+hidden size_t __strlen_generic(const char *);
+#include "../strlen.c"
+#undef strlen
+
+typedef char v32 __attribute__((__vector_size__(32), __may_alias__));
+
+/* Aligned 32-byte loads never cross into a page the string does not
+ * occupy, so reading past the terminator is harmless. */
+__attribute__((__target__("avx2")))
+static size_t strlen_avx2(const char *s)
+{
+	const v32 *w = (const void *)((uintptr_t)s & -32);
+	unsigned m = __builtin_ia32_pmovmskb256(*w == (v32){0});
+	m >>= (uintptr_t)s % 32;
+	if (m) return __builtin_ctz(m);
+	for (w++; !(m = __builtin_ia32_pmovmskb256(*w == (v32){0})); w++);
+	return (const char *)w - s + __builtin_ctz(m);
+}
+
+size_t strlen(const char *s)
+{
+	if (__cpu_features & CPU_AVX2) return strlen_avx2(s);
+	return __strlen_generic(s);
+}
+
+#else
+
+#include "../strlen.c"
+
+#endif
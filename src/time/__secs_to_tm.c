@@ -1,21 +1,20 @@
 #include "time_impl.h"
 #include <limits.h>
+#include <stdint.h>
 
 /* 2000-03-01 (mod 400 year, immediately after feb29 */
 #define LEAPOCH (946684800LL + 86400*(31+29))
 
 #define DAYS_PER_400Y (365*400 + 97)
-#define DAYS_PER_100Y (365*100 + 24)
-#define DAYS_PER_4Y   (365*4   + 1)
 
 int __secs_to_tm(long long t, struct tm *tm)
 {
 	long long days, secs, years;
-	int remdays, remsecs, remyears;
-	int qc_cycles, c_cycles, q_cycles;
-	int months;
-	int wday, yday, leap;
-	static const char days_in_month[] = {31,30,31,30,31,31,30,31,30,31,31,29};
+	int remdays, remsecs;
+	int qc_cycles, c_cycles, yoff;
+	uint32_t n, yday;
+	uint64_t p;
+	int mon, mday, wday, leap;
 
 	/* Reject time_t values whose year would overflow int */
 	if (t < INT_MIN * 31622400LL || t > INT_MAX * 31622400LL)
@@ -39,38 +38,38 @@ int __secs_to_tm(long long t, struct tm *tm)
 		qc_cycles--;
 	}
 
-	c_cycles = remdays / DAYS_PER_100Y;
-	if (c_cycles == 4) c_cycles--;
-	remdays -= c_cycles * DAYS_PER_100Y;
-
-	q_cycles = remdays / DAYS_PER_4Y;
-	if (q_cycles == 25) q_cycles--;
-	remdays -= q_cycles * DAYS_PER_4Y;
-
-	remyears = remdays / 365;
-	if (remyears == 4) remyears--;
-	remdays -= remyears * 365;
-
-	leap = !remyears && (q_cycles || !c_cycles);
-	yday = remdays + 31 + 28 + leap;
-	if (yday >= 365+leap) yday -= 365+leap;
-
-	years = remyears + 4*q_cycles + 100*c_cycles + 400LL*qc_cycles;
-
-	for (months=0; days_in_month[months] <= remdays; months++)
-		remdays -= days_in_month[months];
-
-	if (months >= 10) {
-		months -= 12;
+	/* Within the 400-year cycle, split into century, year and day of
+	 * the March-based year, then month and day of month, using the
+	 * multiply-and-shift forms of Neri and Schneider, "Euclidean
+	 * affine functions and their application to calendar algorithms",
+	 * in place of successive division and a scan over the months. */
+	n = 4*remdays + 3;
+	c_cycles = n / DAYS_PER_400Y;
+	n = n % DAYS_PER_400Y | 3;
+	p = (uint64_t)2939745 * n;
+	yoff = 100*c_cycles + (int)(p >> 32);
+	yday = (uint32_t)p / 2939745 / 4;
+	n = 2141*yday + 197913;
+	mon = n >> 16;
+	mday = (n & 0xffff) / 2141;
+
+	leap = !(yoff%4) && (yoff%100 || !yoff);
+
+	years = yoff + 400LL*qc_cycles;
+	if (mon > 12) {
+		mon -= 12;
 		years++;
 	}
 
 	if (years+100 > INT_MAX || years+100 < INT_MIN)
 		return -1;
 
+	yday += 31 + 28 + leap;
+	if (yday >= 365+leap) yday -= 365+leap;
+
 	tm->tm_year = years + 100;
-	tm->tm_mon = months + 2;
-	tm->tm_mday = remdays + 1;
+	tm->tm_mon = mon - 1;
+	tm->tm_mday = mday + 1;
 	tm->tm_wday = wday;
 	tm->tm_yday = yday;
 
@@ -8,6 +8,7 @@
 #include "libc.h"
 #include "lock.h"
 #include "fork_impl.h"
+#include "pthread_impl.h"
 
 #define malloc __libc_malloc
 #define calloc undef
@@ -22,18 +23,44 @@ weak_alias(__timezone, timezone);
 weak_alias(__daylight, daylight);
 weak_alias(__tzname, tzname);
 
-static char std_name[TZNAME_MAX+1];
-static char dst_name[TZNAME_MAX+1];
-
-static int dst_off;
-static int r0[5], r1[5];
-
-static const unsigned char *zi, *trans, *index, *types, *abbrevs, *abbrevs_end;
-static size_t map_size;
-
-static char old_tz_buf[32];
-static char *old_tz = old_tz_buf;
-static size_t old_tz_size = sizeof old_tz_buf;
+/* A parsed zone is immutable once published through cur_zone, so
+ * readers only need to pin it (by holding a reference in the global
+ * pins count) while they use it. Zones replaced by a change to TZ are
+ * retired and recycled only once no reader is pinned, which keeps
+ * both the zone and its zoneinfo mapping alive for in-flight lookups.
+ * The pin count is shared rather than per-zone because a per-zone
+ * count could not be taken without first dereferencing the zone. */
+
+struct tz_zone {
+	struct tz_zone *next;
+	unsigned gen;
+	const unsigned char *zi, *trans, *index, *types, *abbrevs, *abbrevs_end;
+	size_t map_size;
+	long timezone;
+	int daylight, dst_off;
+	int r0[5], r1[5];
+	const char *tzname[2];
+	char std_name[TZNAME_MAX+1];
+	char dst_name[TZNAME_MAX+1];
+	char *name;
+	size_t name_size;
+};
+
+static char builtin_name[32];
+static struct tz_zone builtin_zone = {
+	.name = builtin_name, .name_size = sizeof builtin_name
+};
+
+/* Used, with a null name so that it never matches TZ, only when no
+ * storage could be obtained for a new zone. */
+static struct tz_zone utc_zone = {
+	.gen = 1, .tzname = { __utc, __utc }
+};
+
+static struct tz_zone *volatile cur_zone;
+static struct tz_zone *retired, *spare = &builtin_zone;
+static volatile int pins;
+static unsigned zone_gen = 1;
 
 static volatile int lock[1];
 volatile int *const __timezone_lockptr = lock;
@@ -122,37 +149,79 @@ static size_t zi_dotprod(const unsigned char *z, const unsigned char *v, size_t
 	return y;
 }
 
-static void do_tzset()
+static const char *get_tz()
+{
+	const char *s = getenv("TZ");
+	if (!s) s = "/etc/localtime";
+	if (!*s) s = __utc;
+	return s;
+}
+
+static struct tz_zone *alloc_zone(size_t len)
+{
+	struct tz_zone *z, **pz;
+	for (pz=&spare; (z=*pz); pz=&z->next) {
+		if (z->name_size >= len) {
+			*pz = z->next;
+			return z;
+		}
+	}
+	/* Avoid free so as not to pull it into static programs; zones
+	 * that are no longer in use are recycled through spare instead. */
+	if (len < 64) len = 64;
+	z = malloc(sizeof *z + len);
+	if (!z) return 0;
+	z->name = (char *)(z+1);
+	z->name_size = len;
+	return z;
+}
+
+static void retire_zone(struct tz_zone *z)
+{
+	if (z && z != &utc_zone) {
+		z->next = retired;
+		retired = z;
+	}
+	/* Publishing the new zone happened before this check, so any
+	 * reader not yet counted in pins will see the new zone. */
+	a_barrier();
+	if (pins) return;
+	while ((z = retired)) {
+		retired = z->next;
+		if (z->zi) __munmap((void *)z->zi, z->map_size);
+		z->next = spare;
+		spare = z;
+	}
+}
+
+static struct tz_zone *do_tzset()
 {
 	char buf[NAME_MAX+25], *pathname=buf+24;
 	const char *try, *s, *p;
 	const unsigned char *map = 0;
 	size_t i;
+	struct tz_zone *z = cur_zone, *old;
 	static const char search[] =
 		"/usr/share/zoneinfo/\0/share/zoneinfo/\0/etc/zoneinfo/\0";
 
-	s = getenv("TZ");
-	if (!s) s = "/etc/localtime";
-	if (!*s) s = __utc;
-
-	if (old_tz && !strcmp(s, old_tz)) return;
+	s = get_tz();
 
-	for (i=0; i<5; i++) r0[i] = r1[i] = 0;
+	if (z && z->name && !strcmp(s, z->name)) return z;
 
-	if (zi) __munmap((void *)zi, map_size);
-
-	/* Cache the old value of TZ to check if it has changed. Avoid
-	 * free so as not to pull it into static programs. Growth
-	 * strategy makes it so free would have minimal benefit anyway. */
+	/* Cache the value of TZ in the new zone to check if it has
+	 * changed. */
 	i = strlen(s);
 	if (i > PATH_MAX+1) s = __utc, i = 3;
-	if (i >= old_tz_size) {
-		old_tz_size *= 2;
-		if (i >= old_tz_size) old_tz_size = i+1;
-		if (old_tz_size > PATH_MAX+2) old_tz_size = PATH_MAX+2;
-		old_tz = malloc(old_tz_size);
+	z = alloc_zone(i+1);
+	if (!z) {
+		z = &utc_zone;
+		goto publish;
 	}
-	if (old_tz) memcpy(old_tz, s, i+1);
+	memcpy(z->name, s, i+1);
+
+	z->zi = 0;
+	z->map_size = 0;
+	for (i=0; i<5; i++) z->r0[i] = z->r1[i] = 0;
 
 	int posix_form = 0;
 	if (*s != ':') {
@@ -172,7 +241,7 @@ static void do_tzset()
 		if (*s == ':') s++;
 		if (*s == '/' || *s == '.') {
 			if (!libc.secure || !strcmp(s, "/etc/localtime"))
-				map = __map_file(s, &map_size);
+				map = __map_file(s, &z->map_size);
 		} else {
 			size_t l = strlen(s);
 			if (l <= NAME_MAX && !strchr(s, '.')) {
@@ -181,88 +250,136 @@ static void do_tzset()
 				for (try=search; !map && *try; try+=l+1) {
 					l = strlen(try);
 					memcpy(pathname-l, try, l);
-					map = __map_file(pathname-l, &map_size);
+					map = __map_file(pathname-l, &z->map_size);
 				}
 			}
 		}
 		if (!map) s = __utc;
 	}
-	if (map && (map_size < 44 || memcmp(map, "TZif", 4))) {
-		__munmap((void *)map, map_size);
+	if (map && (z->map_size < 44 || memcmp(map, "TZif", 4))) {
+		__munmap((void *)map, z->map_size);
 		map = 0;
 		s = __utc;
 	}
 
-	zi = map;
+	z->zi = map;
 	if (map) {
 		int scale = 2;
 		if (map[4]!='1') {
-			size_t skip = zi_dotprod(zi+20, VEC(1,1,8,5,6,1), 6);
-			trans = zi+skip+44+44;
+			size_t skip = zi_dotprod(map+20, VEC(1,1,8,5,6,1), 6);
+			z->trans = map+skip+44+44;
 			scale++;
 		} else {
-			trans = zi+44;
+			z->trans = map+44;
 		}
-		index = trans + (zi_read32(trans-12) << scale);
-		types = index + zi_read32(trans-12);
-		abbrevs = types + 6*zi_read32(trans-8);
-		abbrevs_end = abbrevs + zi_read32(trans-4);
-		if (zi[map_size-1] == '\n') {
-			for (s = (const char *)zi+map_size-2; *s!='\n'; s--);
+		z->index = z->trans + (zi_read32(z->trans-12) << scale);
+		z->types = z->index + zi_read32(z->trans-12);
+		z->abbrevs = z->types + 6*zi_read32(z->trans-8);
+		z->abbrevs_end = z->abbrevs + zi_read32(z->trans-4);
+		if (map[z->map_size-1] == '\n') {
+			for (s = (const char *)map+z->map_size-2; *s!='\n'; s--);
 			s++;
 		} else {
 			const unsigned char *p;
-			__tzname[0] = __tzname[1] = 0;
-			__daylight = __timezone = dst_off = 0;
-			for (p=types; p<abbrevs; p+=6) {
-				if (!p[4] && !__tzname[0]) {
-					__tzname[0] = (char *)abbrevs + p[5];
-					__timezone = -zi_read32(p);
+			z->tzname[0] = z->tzname[1] = 0;
+			z->daylight = z->timezone = z->dst_off = 0;
+			for (p=z->types; p<z->abbrevs; p+=6) {
+				if (!p[4] && !z->tzname[0]) {
+					z->tzname[0] = (char *)z->abbrevs + p[5];
+					z->timezone = -zi_read32(p);
 				}
-				if (p[4] && !__tzname[1]) {
-					__tzname[1] = (char *)abbrevs + p[5];
-					dst_off = -zi_read32(p);
-					__daylight = 1;
+				if (p[4] && !z->tzname[1]) {
+					z->tzname[1] = (char *)z->abbrevs + p[5];
+					z->dst_off = -zi_read32(p);
+					z->daylight = 1;
 				}
 			}
-			if (!__tzname[0]) __tzname[0] = __tzname[1];
-			if (!__tzname[0]) __tzname[0] = (char *)__utc;
-			if (!__daylight) {
-				__tzname[1] = __tzname[0];
-				dst_off = __timezone;
+			if (!z->tzname[0]) z->tzname[0] = z->tzname[1];
+			if (!z->tzname[0]) z->tzname[0] = __utc;
+			if (!z->daylight) {
+				z->tzname[1] = z->tzname[0];
+				z->dst_off = z->timezone;
 			}
-			return;
+			goto publish;
 		}
 	}
 
 	if (!s) s = __utc;
-	getname(std_name, &s);
-	__tzname[0] = std_name;
-	__timezone = getoff(&s);
-	getname(dst_name, &s);
-	__tzname[1] = dst_name;
-	if (dst_name[0]) {
-		__daylight = 1;
+	getname(z->std_name, &s);
+	z->tzname[0] = z->std_name;
+	z->timezone = getoff(&s);
+	getname(z->dst_name, &s);
+	z->tzname[1] = z->dst_name;
+	if (z->dst_name[0]) {
+		z->daylight = 1;
 		if (*s == '+' || *s=='-' || *s-'0'<10U)
-			dst_off = getoff(&s);
+			z->dst_off = getoff(&s);
 		else
-			dst_off = __timezone - 3600;
+			z->dst_off = z->timezone - 3600;
 	} else {
-		__daylight = 0;
-		dst_off = __timezone;
+		z->daylight = 0;
+		z->dst_off = z->timezone;
 	}
 
-	if (*s == ',') s++, getrule(&s, r0);
-	if (*s == ',') s++, getrule(&s, r1);
+	if (*s == ',') s++, getrule(&s, z->r0);
+	if (*s == ',') s++, getrule(&s, z->r1);
+
+publish:
+	if (z != &utc_zone) z->gen = ++zone_gen;
+	__tzname[0] = (char *)z->tzname[0];
+	__tzname[1] = (char *)z->tzname[1];
+	__timezone = z->timezone;
+	__daylight = z->daylight;
+	a_barrier();
+	old = cur_zone;
+	cur_zone = z;
+	if (old != z) retire_zone(old);
+	return z;
+}
+
+/* Obtain the current zone, pinned against recycling. Only when TZ has
+ * changed since the zone was parsed is the lock needed. */
+
+static struct tz_zone *get_zone()
+{
+	const char *s = get_tz();
+	struct tz_zone *z;
+
+	a_inc(&pins);
+	z = cur_zone;
+	if (z && z->name && !strcmp(s, z->name)) return z;
+	a_dec(&pins);
+
+	LOCK(lock);
+	z = do_tzset();
+	a_inc(&pins);
+	UNLOCK(lock);
+	return z;
+}
+
+static void put_zone()
+{
+	a_dec(&pins);
+}
+
+static long long zi_trans(const struct tz_zone *z, size_t m, int scale)
+{
+	uint64_t x = zi_read32(z->trans + (m<<scale));
+	if (scale == 3) return x<<32 | zi_read32(z->trans + (m<<scale) + 4);
+	return (int32_t)x;
 }
 
 /* Search zoneinfo rules to find the one that applies to the given time,
- * and determine alternate opposite-DST-status rule that may be needed. */
+ * and determine alternate opposite-DST-status rule that may be needed.
+ * For universal time, the interval of times sharing the result is
+ * narrowed into [*lo, *hi). */
 
-static size_t scan_trans(long long t, int local, size_t *alt)
+static size_t scan_trans(const struct tz_zone *z, long long t, int local, size_t *alt, long long *lo, long long *hi)
 {
-	int scale = 3 - (trans == zi+44);
-	uint64_t x;
+	const unsigned char *trans = z->trans, *index = z->index;
+	const unsigned char *types = z->types;
+	int scale = 3 - (trans == z->zi+44);
+	long long x;
 	int off = 0;
 
 	size_t a = 0, n = (index-trans)>>scale, m;
@@ -275,11 +392,9 @@ static size_t scan_trans(long long t, int local, size_t *alt)
 	/* Binary search for 'most-recent rule before t'. */
 	while (n > 1) {
 		m = a + n/2;
-		x = zi_read32(trans + (m<<scale));
-		if (scale == 3) x = x<<32 | zi_read32(trans + (m<<scale) + 4);
-		else x = (int32_t)x;
+		x = zi_trans(z, m, scale);
 		if (local) off = (int32_t)zi_read32(types + 6 * index[m-1]);
-		if (t - off < (int64_t)x) {
+		if (t - off < x) {
 			n /= 2;
 		} else {
 			a = m;
@@ -290,24 +405,28 @@ static size_t scan_trans(long long t, int local, size_t *alt)
 	/* First and last entry are special. First means to use lowest-index
 	 * non-DST type. Last means to apply POSIX-style rule if available. */
 	n = (index-trans)>>scale;
-	if (a == n-1) return -1;
+	if (a == n-1) {
+		*lo = zi_trans(z, a, scale);
+		return -1;
+	}
 	if (a == 0) {
-		x = zi_read32(trans);
-		if (scale == 3) x = x<<32 | zi_read32(trans + 4);
-		else x = (int32_t)x;
+		x = zi_trans(z, 0, scale);
 		/* Find the lowest non-DST type, or 0 if none. */
 		size_t j = 0;
-		for (size_t i=abbrevs-types; i; i-=6) {
+		for (size_t i=z->abbrevs-types; i; i-=6) {
 			if (!types[i-6+4]) j = i-6;
 		}
 		if (local) off = (int32_t)zi_read32(types + j);
 		/* If t is before first transition, use the above-found type
 		 * and the index-zero (after transition) type as the alt. */
-		if (t - off < (int64_t)x) {
+		if (t - off < x) {
 			if (alt) *alt = index[0];
+			*hi = x;
 			return j/6;
 		}
 	}
+	*lo = zi_trans(z, a, scale);
+	*hi = zi_trans(z, a+1, scale);
 
 	/* Try to find a neighboring opposite-DST-status rule. */
 	if (alt) {
@@ -359,27 +478,42 @@ static long long rule_to_secs(const int *rule, int year)
  * indicate whether DST is in effect at the queried time, and will give both
  * the GMT offset for the active zone/DST rule and the opposite DST. This
  * enables a caller to efficiently adjust for the case where an explicit
- * DST specification mismatches what would be in effect at the time. */
+ * DST specification mismatches what would be in effect at the time.
+ *
+ * Results for universal time are cached per thread along with the
+ * interval over which they hold, so that runs of nearby timestamps
+ * need neither the transition search nor the DST rule computation. */
 
 void __secs_to_zone(long long t, int local, int *isdst, long *offset, long *oppoff, const char **zonename)
 {
-	LOCK(lock);
-
-	do_tzset();
+	struct tz_zone *z = get_zone();
+	struct pthread *self = __pthread_self();
+	long long lo = LLONG_MIN, hi = LLONG_MAX;
+	long opp;
+
+	if (!oppoff) oppoff = &opp;
+	if (!local && self->tz_cache.gen == z->gen
+	    && t >= self->tz_cache.lo && t < self->tz_cache.hi) {
+		*isdst = self->tz_cache.isdst;
+		*offset = self->tz_cache.off;
+		*oppoff = self->tz_cache.oppoff;
+		*zonename = self->tz_cache.zone;
+		put_zone();
+		return;
+	}
 
-	if (zi) {
-		size_t alt, i = scan_trans(t, local, &alt);
+	if (z->zi) {
+		size_t alt, i = scan_trans(z, t, local, &alt, &lo, &hi);
 		if (i != -1) {
-			*isdst = types[6*i+4];
-			*offset = (int32_t)zi_read32(types+6*i);
-			*zonename = (const char *)abbrevs + types[6*i+5];
-			if (oppoff) *oppoff = (int32_t)zi_read32(types+6*alt);
-			UNLOCK(lock);
-			return;
+			*isdst = z->types[6*i+4];
+			*offset = (int32_t)zi_read32(z->types+6*i);
+			*zonename = (const char *)z->abbrevs + z->types[6*i+5];
+			*oppoff = (int32_t)zi_read32(z->types+6*alt);
+			goto done;
 		}
 	}
 
-	if (!__daylight) goto std;
+	if (!z->daylight) goto std;
 
 	/* FIXME: may be broken if DST changes right at year boundary?
 	 * Also, this could be more efficient.*/
@@ -387,33 +521,66 @@ void __secs_to_zone(long long t, int local, int *isdst, long *offset, long *oppo
 	while (__year_to_secs(y, 0) > t) y--;
 	while (__year_to_secs(y+1, 0) < t) y++;
 
-	long long t0 = rule_to_secs(r0, y);
-	long long t1 = rule_to_secs(r1, y);
+	long long t0 = rule_to_secs(z->r0, y);
+	long long t1 = rule_to_secs(z->r1, y);
+
+	/* Any time strictly after the start of the year converges on
+	 * the same year above, so that open interval can be cached. */
+	long long ys = __year_to_secs(y, 0) + 1, ye = __year_to_secs(y+1, 0);
+	if (lo < ys) lo = ys;
+	if (hi > ye) hi = ye;
 
 	if (!local) {
-		t0 += __timezone;
-		t1 += dst_off;
+		t0 += z->timezone;
+		t1 += z->dst_off;
 	}
 	if (t0 < t1) {
-		if (t >= t0 && t < t1) goto dst;
+		if (t >= t0 && t < t1) {
+			if (lo < t0) lo = t0;
+			if (hi > t1) hi = t1;
+			goto dst;
+		}
+		if (t < t0) {
+			if (hi > t0) hi = t0;
+		} else {
+			if (lo < t1) lo = t1;
+		}
 		goto std;
 	} else {
-		if (t >= t1 && t < t0) goto std;
+		if (t >= t1 && t < t0) {
+			if (lo < t1) lo = t1;
+			if (hi > t0) hi = t0;
+			goto std;
+		}
+		if (t < t1) {
+			if (hi > t1) hi = t1;
+		} else {
+			if (lo < t0) lo = t0;
+		}
 		goto dst;
 	}
 std:
 	*isdst = 0;
-	*offset = -__timezone;
-	if (oppoff) *oppoff = -dst_off;
-	*zonename = __tzname[0];
-	UNLOCK(lock);
-	return;
+	*offset = -z->timezone;
+	*oppoff = -z->dst_off;
+	*zonename = z->tzname[0];
+	goto done;
 dst:
 	*isdst = 1;
-	*offset = -dst_off;
-	if (oppoff) *oppoff = -__timezone;
-	*zonename = __tzname[1];
-	UNLOCK(lock);
+	*offset = -z->dst_off;
+	*oppoff = -z->timezone;
+	*zonename = z->tzname[1];
+done:
+	if (!local) {
+		self->tz_cache.gen = z->gen;
+		self->tz_cache.lo = lo;
+		self->tz_cache.hi = hi;
+		self->tz_cache.isdst = *isdst;
+		self->tz_cache.off = *offset;
+		self->tz_cache.oppoff = *oppoff;
+		self->tz_cache.zone = *zonename;
+	}
+	put_zone();
 }
 
 static void __tzset()
@@ -428,11 +595,10 @@ weak_alias(__tzset, tzset);
 const char *__tm_to_tzname(const struct tm *tm)
 {
 	const void *p = tm->__tm_zone;
-	LOCK(lock);
-	do_tzset();
-	if (p != __utc && p != __tzname[0] && p != __tzname[1] &&
-	    (!zi || (uintptr_t)p-(uintptr_t)abbrevs >= abbrevs_end - abbrevs))
+	struct tz_zone *z = get_zone();
+	if (p != __utc && p != z->tzname[0] && p != z->tzname[1] &&
+	    (!z->zi || (uintptr_t)p-(uintptr_t)z->abbrevs >= z->abbrevs_end - z->abbrevs))
 		p = "";
-	UNLOCK(lock);
+	put_zone();
 	return p;
 }
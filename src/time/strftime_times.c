@@ -0,0 +1,78 @@
+#define _GNU_SOURCE
+#include <time.h>
+#include <string.h>
+#include "locale_impl.h"
+#include "time_impl.h"
+
+/* Length of the longest leading part of f, including any literal text
+ * following it, whose conversions depend only on the calendar date. */
+
+static size_t date_prefix(const char *f)
+{
+	size_t i, j;
+	for (i=j=0; f[i]; ) {
+		if (f[i] != '%') {
+			j = ++i;
+			continue;
+		}
+		i++;
+		if (f[i] == '-' || f[i] == '_' || f[i] == '0') i++;
+		if (f[i] == '+') i++;
+		while (f[i]-'0' < 10U) i++;
+		if (f[i] == 'E' || f[i] == 'O') i++;
+		if (!f[i] || !strchr("aAbBhCdeDFgGjmntuUVwWyY%", f[i])) break;
+		j = ++i;
+	}
+	return j;
+}
+
+size_t strftime_times(char *restrict s, size_t stride, const char *restrict f, const time_t *restrict t, size_t n, int utc)
+{
+	locale_t loc = CURRENT_LOCALE;
+	char pf[128];
+	const char *rest;
+	struct tm tm;
+	size_t i, j, k = 0, l = 0, m;
+	int year = 0, yday = -1;
+
+	/* Output of the date-only prefix of the format is reused from
+	 * the previous entry for times on the same day, and that of
+	 * the whole format for repeats of the same time. */
+	j = date_prefix(f);
+	if (j >= sizeof pf) j = 0;
+	memcpy(pf, f, j);
+	pf[j] = 0;
+	rest = f + j;
+
+	for (i=0; i<n; i++, s+=stride) {
+		if (i && t[i] == t[i-1]) {
+			memcpy(s, s-stride, l+1);
+			continue;
+		}
+		if (!(utc ? __gmtime_r(t+i, &tm) : __localtime_r(t+i, &tm)))
+			break;
+		if (!j) {
+			k = 0;
+		} else if (tm.tm_year == year && tm.tm_yday == yday) {
+			memcpy(s, s-stride, k);
+		} else {
+			k = __strftime_l(s, stride, pf, &tm, loc);
+			if (!k) {
+				yday = -1;
+				goto full;
+			}
+			year = tm.tm_year;
+			yday = tm.tm_yday;
+		}
+		m = __strftime_l(s+k, stride-k, rest, &tm, loc);
+		if (m || !*rest) {
+			l = k + m;
+			continue;
+		}
+full:
+		/* An empty or truncated remainder cannot be told apart,
+		 * so let the whole format decide as strftime would. */
+		if (!(l = __strftime_l(s, stride, f, &tm, loc))) break;
+	}
+	return i;
+}